@@ -0,0 +1,93 @@
+/**
+ * @file corpus.hpp
+ * @brief Generator of the synthetic email corpus.
+ *
+ * @author Maxim <john.jasper.doe@gmail.com>
+ * @date 2020
+ */
+
+#ifndef BENCH_CORPUS_HPP_
+#define BENCH_CORPUS_HPP_
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/** @brief The namespace of the Benchmarks */
+namespace bench {
+
+/** @brief Params of the corpus. */
+struct corpus_param {
+  /** @brief Number of emails. */
+  std::size_t records{100000};
+  /** @brief Min length of the local part. */
+  std::size_t min_len{4};
+  /** @brief Max length of the local part. */
+  std::size_t max_len{16};
+  /** @brief Number of distinct hot prefixes. */
+  std::size_t prefixes{1000};
+  /** @brief Zipf exponent of the hot prefixes, 0 - uniform. */
+  double skew{1.0};
+  /** @brief Seed of the generator. */
+  unsigned seed{42};
+};
+
+/**
+ * @brief Generate the corpus.
+ *
+ * @details
+ * Every email is "<local>@<domain>". The local part starts with one of the
+ * hot prefixes picked by a Zipf distribution, so a few prefixes are very
+ * common, and is completed with random letters up to a length drawn
+ * uniformly from [min_len, max_len].
+ *
+ * @param [in] prm - params of the corpus.
+ * @return Newline separated emails.
+ */
+inline std::string make_corpus(const corpus_param& prm) {
+  std::mt19937 gen(prm.seed);
+  std::uniform_int_distribution<int> letter('a', 'z');
+  std::uniform_int_distribution<std::size_t> len(prm.min_len, std::max(prm.min_len, prm.max_len));
+
+  auto random_str = [&](std::size_t size) {
+    std::string res(size, ' ');
+    std::generate(res.begin(), res.end(), [&] { return static_cast<char>(letter(gen)); });
+    return res;
+  };
+
+  /* hot prefixes and the Zipf CDF over them */
+  std::size_t prefix_len = std::max<std::size_t>(1, prm.min_len / 2);
+  std::vector<std::string> hot;
+  std::vector<double> cdf;
+  double acc = 0;
+  for (std::size_t i = 0; i != std::max<std::size_t>(1, prm.prefixes); ++i) {
+    hot.push_back(random_str(prefix_len));
+    acc += 1.0 / std::pow(static_cast<double>(i + 1), prm.skew);
+    cdf.push_back(acc);
+  }
+  std::uniform_real_distribution<double> pick(0, acc);
+
+  const std::vector<std::string> domains{"otus.owl", "example.com", "mail.org"};
+
+  std::string res;
+  for (std::size_t i = 0; i != prm.records; ++i) {
+    auto rank = std::lower_bound(cdf.begin(), cdf.end(), pick(gen)) - cdf.begin();
+    std::string local = hot[static_cast<std::size_t>(rank)];
+    std::size_t size = len(gen);
+    if (size > local.size())
+      local += random_str(size - local.size());
+
+    res += local;
+    res += '@';
+    res += domains[i % domains.size()];
+    res += '\n';
+  }
+  return res;
+}
+
+} /* bench:: */
+
+#endif /* BENCH_CORPUS_HPP_ */
@@ -0,0 +1,246 @@
+/**
+ * @file mapreduce_bench.cpp
+ * @brief Benchmark of the kernels and of the whole job.
+ *
+ * @author Maxim <john.jasper.doe@gmail.com>
+ * @date 2020
+ */
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "boost/program_options.hpp"
+
+#include "bench/corpus.hpp"
+
+#include "core/mapreduce.hpp"
+#include "core/trie_job.hpp"
+
+#include "common/counter.hpp"
+#include "common/merge.hpp"
+#include "common/sort.hpp"
+#include "common/split.hpp"
+#include "common/tokenizer.hpp"
+
+namespace {
+
+using view_counter_t = common::counter<std::string_view>;
+using str_counter_t = common::counter<std::string>;
+
+/** @brief Params of the benchmark. */
+struct param_t {
+  bench::corpus_param corpus;
+  std::size_t threads;
+  int reps;
+};
+
+void get_param(int argc, const char* argv[], param_t& param) {
+  namespace po = boost::program_options;
+
+  bench::corpus_param& corpus = param.corpus;
+  po::options_description desc("Options");
+  auto add = desc.add_options();
+  add("help,h", "This screen");
+  add("records", po::value(&corpus.records)->default_value(100000), "Number of emails");
+  add("min-len", po::value(&corpus.min_len)->default_value(4), "Min length of the local part");
+  add("max-len", po::value(&corpus.max_len)->default_value(16), "Max length of the local part");
+  add("prefixes", po::value(&corpus.prefixes)->default_value(1000), "Number of hot prefixes");
+  add("skew", po::value(&corpus.skew)->default_value(1.0), "Zipf exponent, 0 - uniform");
+  add("seed", po::value(&corpus.seed)->default_value(42), "Seed of the corpus");
+  add("threads", po::value(&param.threads)->default_value(8),
+      "Max number of map and reduce tasks of the sweep");
+  add("reps", po::value(&param.reps)->default_value(3), "Repetitions, the best one counts");
+
+  po::variables_map vm;
+  po::store(po::parse_command_line(argc, argv, desc), vm);
+  po::notify(vm);
+
+  if (vm.count("help")) {
+    std::cout << desc << std::endl;
+    std::exit(EXIT_SUCCESS);
+  }
+}
+
+/**
+ * @brief Measure the best time of the function.
+ * @param [in] reps - repetitions.
+ * @param [in] setup - makes fresh input for every repetition, is not measured.
+ * @param [in] func - measured function, takes the input.
+ * @return Milliseconds.
+ */
+template <class S, class F>
+double measure(int reps, S&& setup, F&& func) {
+  using clock_t = std::chrono::steady_clock;
+
+  double best = 0;
+  for (int rep = 0; rep != reps; ++rep) {
+    auto input = setup();
+    auto start = clock_t::now();
+    auto res = func(std::move(input));
+    std::chrono::duration<double, std::milli> ms = clock_t::now() - start;
+    if (rep == 0 || ms.count() < best)
+      best = ms.count();
+    /* keep the result alive until the clock is read */
+    static_cast<void>(res);
+  }
+  return best;
+}
+
+void print_kernel(const std::string& name, std::size_t records, double ms) {
+  std::cout << "{\"bench\": \"kernel\", \"kernel\": \"" << name << "\", \"records\": " << records
+            << ", \"ms\": " << ms << "}" << std::endl;
+}
+
+void print_run(const std::string& engine, const std::string& shuffle, std::size_t mnum,
+               std::size_t rnum, std::size_t records, double ms) {
+  std::cout << "{\"bench\": \"run\", \"engine\": \"" << engine << "\", \"shuffle\": \"" << shuffle
+            << "\", \"mnum\": " << mnum << ", \"rnum\": " << rnum << ", \"records\": " << records
+            << ", \"ms\": " << ms << ", \"records_per_s\": " << records / (ms / 1000) << "}"
+            << std::endl;
+}
+
+/** @brief Sorted map output of every part of the corpus. */
+std::vector<std::vector<view_counter_t>> sorted_runs(std::string_view buf, std::size_t parts) {
+  std::vector<std::vector<view_counter_t>> res;
+  for (std::vector<std::string_view>& part : common::split_records(buf, parts)) {
+    res.push_back(yamr::core::mapper_func<view_counter_t, std::string_view>(std::move(part)));
+    common::sort_records(res.back());
+  }
+  return res;
+}
+
+void bench_kernels(const param_t& prm, const std::string& corpus) {
+  using namespace yamr::core;
+  const int reps = prm.reps;
+  const std::size_t parts = prm.threads;
+  std::size_t records = prm.corpus.records;
+
+  print_kernel("split_string", records,
+               measure(reps, [&] { return corpus; },
+                       [](std::string&& str) { return common::split(str); }));
+
+  const std::pair<std::string, common::simd_level> levels[] = {
+      {"scalar", common::simd_level::scalar},
+      {"sse2", common::simd_level::sse2},
+      {"avx2", common::simd_level::avx2}};
+  for (const auto& [name, level] : levels) {
+    if (level > common::best_simd_level())
+      continue;
+    print_kernel("tokenize_" + name, records,
+                 measure(reps, [] { return 0; },
+                         [&, level = level](int) { return common::tokenize(corpus, level); }));
+  }
+
+  print_kernel("split_records", records,
+               measure(reps, [] { return 0; },
+                       [&](int) { return common::split_records(corpus, parts); }));
+
+  print_kernel("split", records,
+               measure(reps, [&] { return common::split_records(corpus, 1).front(); },
+                       [&](std::vector<std::string_view>&& lines) {
+                         return common::split(std::move(lines), parts);
+                       }));
+
+  auto map_input = [&] { return common::split_records(corpus, 1).front(); };
+  std::size_t prefixes = mapper_func<view_counter_t, std::string_view>(map_input()).size();
+
+  print_kernel("mapper_func", records,
+               measure(reps, map_input, mapper_func<view_counter_t, std::string_view>));
+
+  mfunc_ptr_t<std::string_view, view_counter_t> erased =
+      mapper_func<view_counter_t, std::string_view>;
+  print_kernel("mapper_std_function", records, measure(reps, map_input, erased));
+
+  print_kernel("mapper_emit", records,
+               measure(reps, map_input, map_each<view_counter_t>(prefix_map<view_counter_t>{})));
+
+  print_kernel("sort_records", prefixes,
+               measure(reps,
+                       [&] { return mapper_func<view_counter_t, std::string_view>(map_input()); },
+                       [](std::vector<view_counter_t>&& data) {
+                         common::sort_records(data);
+                         return data.size();
+                       }));
+
+  print_kernel("merge", prefixes,
+               measure(reps, [&] { return sorted_runs(corpus, parts); },
+                       [](std::vector<std::vector<view_counter_t>>&& runs) {
+                         return common::merge(std::move(runs));
+                       }));
+
+  print_kernel("split_reduce", prefixes,
+               measure(reps, [&] { return common::merge(sorted_runs(corpus, parts)); },
+                       [&](std::vector<view_counter_t>&& data) {
+                         return common::split_reduce(std::move(data), parts);
+                       }));
+
+  print_kernel("reducer_func", prefixes,
+               measure(reps, [&] { return common::merge(sorted_runs(corpus, 1)); },
+                       reducer_func<view_counter_t>));
+
+  print_kernel("sorted_reducer_func", prefixes,
+               measure(reps, [&] { return common::merge(sorted_runs(corpus, 1)); },
+                       sorted_reducer_func<view_counter_t>));
+}
+
+void bench_runs(const param_t& prm, const std::string& corpus) {
+  using namespace yamr::core;
+  std::size_t records = prm.corpus.records;
+
+  const std::pair<std::string, shuffle_mode> modes[] = {{"sort", shuffle_mode::sort_merge},
+                                                        {"hash", shuffle_mode::hash}};
+
+  for (std::size_t mnum = 1; mnum <= prm.threads; mnum *= 2) {
+    for (std::size_t rnum = 1; rnum <= prm.threads; rnum *= 2) {
+      for (const auto& [name, mode] : modes) {
+        auto substr = map_reduce<std::string_view, view_counter_t, view_counter_t, view_counter_t>(
+            mnum, rnum);
+        substr.set_shuffle(mode);
+        double ms = measure(prm.reps, [&] { return common::split_records(corpus, mnum); },
+                            [&](std::vector<std::vector<std::string_view>>&& input) {
+                              return substr.run(std::move(input),
+                                                mapper_func<view_counter_t, std::string_view>,
+                                                nullptr, sorted_reducer_func<view_counter_t>,
+                                                reducer_func<view_counter_t>);
+                            });
+        print_run("substr", name, mnum, rnum, records, ms);
+
+        auto trie =
+            map_reduce<std::string_view, common::prefix_trie, str_counter_t, str_counter_t>(mnum,
+                                                                                            rnum);
+        trie.set_shuffle(mode);
+        ms = measure(prm.reps, [&] { return common::split_records(corpus, mnum); },
+                     [&](std::vector<std::vector<std::string_view>>&& input) {
+                       return trie.run(std::move(input), trie_mapper_func<std::string_view>,
+                                       nullptr, trie_reducer_func<str_counter_t>,
+                                       reducer_func<str_counter_t>);
+                     });
+        print_run("trie", name, mnum, rnum, records, ms);
+      }
+    }
+  }
+}
+
+} /* :: */
+
+/** @brief Main entry point */
+int main(int argc, const char* argv[]) {
+  param_t prm;
+  get_param(argc, argv, prm);
+
+  std::string corpus = bench::make_corpus(prm.corpus);
+
+  /* one JSON object per line */
+  std::cout << "{\"bench\": \"corpus\", \"records\": " << prm.corpus.records
+            << ", \"bytes\": " << corpus.size() << ", \"min_len\": " << prm.corpus.min_len
+            << ", \"max_len\": " << prm.corpus.max_len << ", \"prefixes\": " << prm.corpus.prefixes
+            << ", \"skew\": " << prm.corpus.skew << "}" << std::endl;
+
+  bench_kernels(prm, corpus);
+  bench_runs(prm, corpus);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,75 @@
+/**
+ * @file merge_bench.cpp
+ * @brief Micro-benchmark of the merge kernels.
+ *
+ * @author Maxim <john.jasper.doe@gmail.com>
+ * @date 2020
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "common/counter.hpp"
+#include "common/merge.hpp"
+
+namespace {
+
+using str_counter_t = common::counter<std::string>;
+using runs_t = std::vector<std::vector<str_counter_t>>;
+
+runs_t make_runs(std::size_t runs, std::size_t records, unsigned seed) {
+  std::mt19937 gen(seed);
+  std::uniform_int_distribution<int> len(4, 24);
+  std::uniform_int_distribution<int> chr('a', 'h');
+
+  runs_t res(runs);
+  for (std::size_t i = 0; i != records; ++i) {
+    std::string s(static_cast<std::size_t>(len(gen)), ' ');
+    std::generate(s.begin(), s.end(), [&] { return static_cast<char>(chr(gen)); });
+    res[i % runs].emplace_back(std::move(s));
+  }
+  for (std::vector<str_counter_t>& run : res)
+    std::sort(run.begin(), run.end());
+  return res;
+}
+
+template <class F>
+double measure(F&& func, std::size_t runs, std::size_t records) {
+  using clock_t = std::chrono::steady_clock;
+
+  /* best of three, every repetition gets fresh input */
+  double best = 0;
+  for (int rep = 0; rep != 3; ++rep) {
+    runs_t data = make_runs(runs, records, 42);
+    auto start = clock_t::now();
+    std::vector<str_counter_t> res = func(std::move(data));
+    std::chrono::duration<double, std::milli> ms = clock_t::now() - start;
+    if (rep == 0 || ms.count() < best)
+      best = ms.count();
+  }
+  return best;
+}
+
+} /* :: */
+
+/** @brief Main entry point */
+int main(int argc, const char* argv[]) {
+  std::size_t records = argc > 1 ? std::stoul(argv[1]) : 1000000;
+
+  /* one JSON object per line */
+  for (std::size_t runs : {2, 4, 8, 16, 64}) {
+    double pq = measure([](runs_t&& d) { return common::merge(std::move(d)); }, runs, records);
+    double lt =
+        measure([](runs_t&& d) { return common::merge_tournament(std::move(d)); }, runs, records);
+
+    std::cout << "{\"bench\": \"merge\", \"runs\": " << runs << ", \"records\": " << records
+              << ", \"priority_queue_ms\": " << pq << ", \"loser_tree_ms\": " << lt << "}"
+              << std::endl;
+  }
+
+  return EXIT_SUCCESS;
+}
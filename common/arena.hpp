@@ -0,0 +1,96 @@
+/**
+ * @file arena.hpp
+ * @brief Definition of the class "String Arena".
+ *
+ * @author Maxim <john.jasper.doe@gmail.com>
+ * @date 2020
+ */
+
+#ifndef COMMON_ARENA_HPP_
+#define COMMON_ARENA_HPP_
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+/** @brief The namespace of the Common */
+namespace common {
+
+/**
+ * @brief Class "String Arena".
+ *
+ * @details
+ * Bump allocator for string bytes. Memory is taken from the heap in big
+ * chunks and is never freed one string at a time, all strings are released
+ * at once by "clear" or by the destructor. Views returned by "intern" are
+ * valid until then. The arena is not thread-safe, use one arena per task.
+ */
+class string_arena {
+  /** @brief Size of a regular chunk. */
+  static constexpr std::size_t chunk_size = 64 * 1024;
+
+  std::vector<std::unique_ptr<char[]>> chunks_;
+  char* cur_{nullptr};
+  std::size_t left_{0};
+  std::size_t bytes_{0};
+
+public:
+  string_arena() = default;
+  string_arena(string_arena&&) = default;
+  string_arena& operator=(string_arena&&) = default;
+
+  /**
+   * @brief Allocate uninitialized bytes.
+   * @param [in] size - number of bytes.
+   * @return Pointer to the bytes.
+   */
+  char* allocate(std::size_t size) {
+    if (size > left_) {
+      std::size_t len = std::max(size, chunk_size);
+      chunks_.push_back(std::make_unique<char[]>(len));
+      cur_ = chunks_.back().get();
+      left_ = len;
+      bytes_ += len;
+    }
+
+    char* res = cur_;
+    cur_ += size;
+    left_ -= size;
+    return res;
+  }
+
+  /**
+   * @brief Copy a string into the arena.
+   * @param [in] str - string.
+   * @return View of the copy.
+   */
+  std::string_view intern(std::string_view str) {
+    if (str.empty())
+      return std::string_view{};
+    char* dst = allocate(str.size());
+    std::memcpy(dst, str.data(), str.size());
+    return std::string_view(dst, str.size());
+  }
+
+  /**
+   * @brief Get number of bytes taken from the heap.
+   * @return Number of bytes.
+   */
+  std::size_t size() const noexcept {
+    return bytes_;
+  }
+
+  /** @brief Release all strings. */
+  void clear() noexcept {
+    chunks_.clear();
+    cur_ = nullptr;
+    left_ = 0;
+    bytes_ = 0;
+  }
+};
+
+} /* common:: */
+
+#endif /* COMMON_ARENA_HPP_ */
@@ -0,0 +1,186 @@
+/**
+ * @file checkpoint.hpp
+ * @brief Definition of the class "Map Checkpoint".
+ *
+ * @author Maxim <john.jasper.doe@gmail.com>
+ * @date 2020
+ */
+
+#ifndef COMMON_CHECKPOINT_HPP_
+#define COMMON_CHECKPOINT_HPP_
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "arena.hpp"
+#include "spill.hpp"
+
+/** @brief The namespace of the Common */
+namespace common {
+
+/**
+ * @brief Get the fingerprint of the records, e.g. of the input part of a map task.
+ * @details Order-sensitive combination of "std::hash" of the records and their number.
+ * @param [in] data - records.
+ * @return Fingerprint.
+ */
+template <class T>
+std::uint64_t records_fingerprint(const std::vector<T>& data) {
+  std::uint64_t res = 14695981039346656037ull ^ data.size();
+  for (const T& obj : data)
+    res = (res ^ std::hash<T>{}(obj)) * 1099511628211ull;
+  return res;
+}
+
+/**
+ * @brief Class "Map Checkpoint".
+ *
+ * @details
+ * Keeps the sorted output of the map tasks in a work directory, so that a
+ * job that failed after the map stage does not map again. The output of a
+ * task is found by the fingerprint of its input part: the parts of the output
+ * (e.g. the buckets of the hash shuffle) are run files "map-<key>-<part>",
+ * written under a temporary name and renamed when complete, then the task is
+ * added to the file "manifest". The manifest is replaced at once after every
+ * task, so a crash leaves either the old or the new one.
+ *
+ * The manifest starts with the fingerprint of the job (types of the records,
+ * shuffle parameters); a directory left by another job is cleaned up. The
+ * map function itself can not be fingerprinted, so every job needs its own
+ * directory. All methods are thread-safe.
+ */
+class map_checkpoint {
+  std::filesystem::path path_;
+  std::string job_;
+
+  mutable std::mutex mtx_;
+  /** @brief Completed tasks: number of output parts by the fingerprint of the input. */
+  std::unordered_map<std::uint64_t, std::size_t> done_;
+
+public:
+  /**
+   * @brief Constructor with param, reads the manifest of the previous run.
+   * @param [in] path - work directory, is created if missing.
+   * @param [in] job - fingerprint of the job.
+   * @throw std::filesystem::filesystem_error - if the directory can not be created.
+   */
+  map_checkpoint(const std::string& path, const std::string& job) : path_(path), job_(job) {
+    std::filesystem::create_directories(path_);
+
+    std::ifstream is(path_ / "manifest");
+    std::string line;
+    if (std::getline(is, line) && line == header()) {
+      std::uint64_t key = 0;
+      std::size_t parts = 0;
+      while (is >> std::hex >> key >> std::dec >> parts)
+        done_[key] = parts;
+    }
+    else
+      remove();
+  }
+
+  map_checkpoint(const map_checkpoint&) = delete;
+  map_checkpoint& operator=(const map_checkpoint&) = delete;
+
+  /**
+   * @brief Read the output of a task completed by a previous run.
+   * @param [in] key - fingerprint of the input part of the task.
+   * @param [out] parts - output parts.
+   * @param [in] arena - arena for the data of the records.
+   * @return "True" - the output is read, "False" - the task must be run, e.g.
+   * it is not completed or its files are damaged.
+   */
+  template <class T>
+  bool load(std::uint64_t key, std::vector<std::vector<T>>& parts, string_arena& arena) const {
+    std::size_t count = 0;
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      auto it = done_.find(key);
+      if (it == done_.end())
+        return false;
+      count = it->second;
+    }
+
+    std::vector<std::vector<T>> res;
+    try {
+      for (std::size_t p = 0; p != count; ++p)
+        res.push_back(read_run<T>(file(key, p), arena));
+    }
+    catch (const std::exception&) {
+      return false;
+    }
+    parts = std::move(res);
+    return true;
+  }
+
+  /**
+   * @brief Save the output of a completed task.
+   * @param [in] key - fingerprint of the input part of the task.
+   * @param [in] parts - output parts.
+   * @throw std::runtime_error - if a file can not be written.
+   */
+  template <class T>
+  void save(std::uint64_t key, const std::vector<std::vector<T>>& parts) {
+    for (std::size_t p = 0; p != parts.size(); ++p) {
+      std::string dst = file(key, p);
+      write_run(parts[p], dst + ".tmp");
+      std::filesystem::rename(dst + ".tmp", dst);
+    }
+
+    std::lock_guard<std::mutex> lock(mtx_);
+    done_[key] = parts.size();
+
+    std::ostringstream os;
+    os << header() << "\n";
+    for (const auto& [task, count] : done_)
+      os << std::hex << task << " " << std::dec << count << "\n";
+
+    std::filesystem::path tmp = path_ / "manifest.tmp";
+    {
+      std::ofstream out(tmp, std::ios::trunc);
+      out << os.str();
+      if (!out.flush())
+        throw std::runtime_error("Can not write checkpoint manifest in " + path_.string());
+    }
+    std::filesystem::rename(tmp, path_ / "manifest");
+  }
+
+  /** @brief Remove the manifest and the output of the tasks, e.g. when the job is done. */
+  void remove() noexcept {
+    std::lock_guard<std::mutex> lock(mtx_);
+    done_.clear();
+
+    std::error_code ec;
+    std::filesystem::remove(path_ / "manifest", ec);
+    for (std::filesystem::directory_iterator it(path_, ec), end; !ec && it != end;
+         it.increment(ec)) {
+      if (it->path().filename().string().compare(0, 4, "map-") == 0) {
+        std::error_code rm_ec;
+        std::filesystem::remove(it->path(), rm_ec);
+      }
+    }
+  }
+
+private:
+  std::string header() const {
+    return "yamr-checkpoint 2 " + job_;
+  }
+
+  std::string file(std::uint64_t key, std::size_t part) const {
+    std::ostringstream name;
+    name << "map-" << std::hex << key << "-" << std::dec << part;
+    return (path_ / name.str()).string();
+  }
+};
+
+} /* common:: */
+
+#endif /* COMMON_CHECKPOINT_HPP_ */
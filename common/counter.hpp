@@ -9,8 +9,10 @@
 #ifndef COMMON_COUNTER_HPP_
 #define COMMON_COUNTER_HPP_
 
+#include <functional>
 #include <string>
 #include <type_traits>
+#include <utility>
 #include <vector>
 
 /** @brief The namespace of the Common */
@@ -41,8 +43,11 @@ class counter {
   mutable size_t count_;
 
 public:
+  using value_type = T;
+
   counter() = delete;
-  explicit counter(T&& data) : data_(data), count_(1) {}
+  explicit counter(T&& data) : data_(std::move(data)), count_(1) {}
+  counter(T&& data, size_t count) : data_(std::move(data)), count_(count) {}
 
   counter(counter&&) = default;
   counter& operator=(counter&&) = default;
@@ -59,6 +64,10 @@ public:
     return data_.size();
   }
 
+  const T& key() const {
+    return data_;
+  }
+
   template <class U>
   friend bool operator<(const counter<U>& lhs, const counter<U>& rhs);
   template <class U>
@@ -89,4 +98,16 @@ inline std::ostream& operator<<(std::ostream& os, const counter<T>& src) {
 
 } /* common:: */
 
+namespace std {
+
+/** @brief Hash of the counter is the hash of its data. */
+template <class T>
+struct hash<common::counter<T>> {
+  std::size_t operator()(const common::counter<T>& obj) const noexcept {
+    return std::hash<T>{}(obj.key());
+  }
+};
+
+} /* std:: */
+
 #endif /* COMMON_COUNTER_HPP_ */
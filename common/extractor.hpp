@@ -56,12 +56,11 @@ public:
 
   /**
    * @brief Extract elem.
+   * @details The element is moved straight out of the container.
    * @return Element.
    */
   T extract() noexcept {
-    T tmp = *next_;
-    ++next_;
-    return tmp;
+    return *next_++;
   }
 
   /**
@@ -0,0 +1,107 @@
+/**
+ * @file loser_tree.hpp
+ * @brief Definition of the class "Loser Tree".
+ *
+ * @author Maxim <john.jasper.doe@gmail.com>
+ * @date 2020
+ */
+
+#ifndef COMMON_LOSER_TREE_HPP_
+#define COMMON_LOSER_TREE_HPP_
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+/** @brief The namespace of the Common */
+namespace common {
+
+/**
+ * @brief Template class "Loser Tree".
+ *
+ * @details
+ * Tournament tree over sorted sources with the interface of
+ * "common::extractor" ("has_next", "val", "extract"). The sources never move:
+ * the inner nodes keep the indices of the losers of their matches and only
+ * the path of the winner is replayed after an extraction, that is about
+ * log2(k) comparisons per element. An exhausted source loses every match.
+ */
+template <class Source>
+class loser_tree {
+  std::vector<Source> sources_;
+  /** @brief Node 0 holds the winner, nodes 1..k-1 hold the losers. */
+  std::vector<std::size_t> tree_;
+
+public:
+  /**
+   * @brief Constructor with param.
+   * @param [in] sources - sorted sources.
+   */
+  explicit loser_tree(std::vector<Source>&& sources)
+    : sources_(std::move(sources)), tree_(std::max<std::size_t>(sources_.size(), 1)) {
+    if (!sources_.empty())
+      tree_[0] = build(1);
+  }
+
+  /**
+   * @brief Is there any next item.
+   * @return "True" - is has next item, otherwise - "False".
+   */
+  bool has_next() const noexcept {
+    return !sources_.empty() && sources_[tree_[0]].has_next();
+  }
+
+  /**
+   * @brief Get the smallest element.
+   * @return Element.
+   */
+  const auto& val() const noexcept {
+    return sources_[tree_[0]].val();
+  }
+
+  /**
+   * @brief Extract the smallest element.
+   * @return Element.
+   */
+  auto extract() {
+    std::size_t winner = tree_[0];
+    auto res = sources_[winner].extract();
+
+    std::size_t k = sources_.size();
+    for (std::size_t node = (winner + k) / 2; node > 0; node /= 2) {
+      if (less(tree_[node], winner))
+        std::swap(tree_[node], winner);
+    }
+    tree_[0] = winner;
+
+    return res;
+  }
+
+private:
+  /** @brief Play the matches of the subtree, returns the winner. */
+  std::size_t build(std::size_t node) {
+    std::size_t k = sources_.size();
+    if (node >= k)
+      return node - k;
+
+    std::size_t lhs = build(2 * node);
+    std::size_t rhs = build(2 * node + 1);
+    if (less(rhs, lhs))
+      std::swap(lhs, rhs);
+    tree_[node] = rhs;
+    return lhs;
+  }
+
+  /** @brief Compare the current elements of two sources. */
+  bool less(std::size_t lhs, std::size_t rhs) const {
+    if (!sources_[lhs].has_next())
+      return false;
+    if (!sources_[rhs].has_next())
+      return true;
+    return sources_[lhs].val() < sources_[rhs].val();
+  }
+};
+
+} /* common:: */
+
+#endif /* COMMON_LOSER_TREE_HPP_ */
@@ -0,0 +1,124 @@
+/**
+ * @file mapped_file.hpp
+ * @brief Definition of the class "Mapped File".
+ *
+ * @author Maxim <john.jasper.doe@gmail.com>
+ * @date 2020
+ */
+
+#ifndef COMMON_MAPPED_FILE_HPP_
+#define COMMON_MAPPED_FILE_HPP_
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+/** @brief The namespace of the Common */
+namespace common {
+
+/**
+ * @brief Read-only memory mapping of a whole file.
+ *
+ * @details
+ * The file content is exposed as a "std::string_view", so records can be
+ * referenced in place without copying them to the heap. All views obtained
+ * from the object are valid until the object is destroyed.
+ */
+class mapped_file {
+  /** @brief Beginning of the mapping. */
+  char* data_{nullptr};
+  /** @brief Size of the mapping in bytes. */
+  std::size_t size_{0};
+
+public:
+  /**
+   * @brief Constructor with param.
+   * @param [in] path - path to the file.
+   * @throw std::system_error - if the file can not be opened or mapped.
+   */
+  explicit mapped_file(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd == -1)
+      throw std::system_error(errno, std::generic_category(), "Can not open file " + path);
+
+    struct stat st {};
+    if (::fstat(fd, &st) == -1) {
+      int err = errno;
+      ::close(fd);
+      throw std::system_error(err, std::generic_category(), "Can not stat file " + path);
+    }
+
+    size_ = static_cast<std::size_t>(st.st_size);
+    if (size_ != 0) {
+      void* addr = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (addr == MAP_FAILED) {
+        int err = errno;
+        ::close(fd);
+        throw std::system_error(err, std::generic_category(), "Can not map file " + path);
+      }
+      data_ = static_cast<char*>(addr);
+      ::madvise(data_, size_, MADV_SEQUENTIAL);
+    }
+
+    ::close(fd);
+  }
+
+  mapped_file(const mapped_file&) = delete;
+  mapped_file& operator=(const mapped_file&) = delete;
+
+  /** @brief Move constructor */
+  mapped_file(mapped_file&& src) noexcept : data_{src.data_}, size_{src.size_} {
+    src.data_ = nullptr;
+    src.size_ = 0;
+  }
+
+  /** @brief Move operator */
+  mapped_file& operator=(mapped_file&& src) noexcept {
+    if (this != &src) {
+      unmap();
+      data_ = src.data_;
+      size_ = src.size_;
+      src.data_ = nullptr;
+      src.size_ = 0;
+    }
+    return *this;
+  }
+
+  ~mapped_file() {
+    unmap();
+  }
+
+  /**
+   * @brief Get the file content.
+   * @return View of the whole mapping.
+   */
+  std::string_view view() const noexcept {
+    return std::string_view(data_, size_);
+  }
+
+  /**
+   * @brief Get size of the file.
+   * @return Size in bytes.
+   */
+  std::size_t size() const noexcept {
+    return size_;
+  }
+
+private:
+  void unmap() noexcept {
+    if (data_ != nullptr)
+      ::munmap(data_, size_);
+    data_ = nullptr;
+    size_ = 0;
+  }
+};
+
+} /* common:: */
+
+#endif /* COMMON_MAPPED_FILE_HPP_ */
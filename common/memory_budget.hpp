@@ -0,0 +1,265 @@
+/**
+ * @file memory_budget.hpp
+ * @brief Definition of the class "Memory Budget".
+ *
+ * @author Maxim <john.jasper.doe@gmail.com>
+ * @date 2020
+ */
+
+#ifndef COMMON_MEMORY_BUDGET_HPP_
+#define COMMON_MEMORY_BUDGET_HPP_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+/** @brief The namespace of the Common */
+namespace common {
+
+/** @brief Exception of a charge that does not fit into the memory budget. */
+class memory_limit_error : public std::runtime_error {
+public:
+  using std::runtime_error::runtime_error;
+};
+
+/**
+ * @brief Class "Memory Budget".
+ *
+ * @details
+ * Accounts the bytes of the records a job holds. The holders charge the
+ * records they take and release them when the records are handed over or
+ * freed, the sizes are the ones of "records_memory" and of the buffers the
+ * holders keep. A charge over the limit either fails softly ("try_charge"),
+ * so the holder can spill or cut its work into smaller parts, waits for the
+ * bytes of other holders ("acquire"), or throws ("charge"), so the job stops
+ * with a clear error before the process runs out of memory. All methods are
+ * thread-safe.
+ */
+class memory_budget {
+  /** @brief Limit in bytes, zero - no limit, the usage is still accounted. */
+  std::size_t limit_{0};
+  std::atomic<std::size_t> used_{0};
+  std::atomic<std::size_t> peak_{0};
+
+  std::mutex mtx_;
+  std::condition_variable cv_;
+  /** @brief Number of the leases given out, see "acquire". */
+  std::size_t leases_{0};
+  /** @brief Number of the holders waiting in "acquire". */
+  std::atomic<std::size_t> waiting_{0};
+
+public:
+  /**
+   * @brief Class "Lease".
+   * @details Bytes charged by "acquire", released when the lease is destroyed,
+   * so the holders waiting for them are not left waiting when the holder fails.
+   */
+  class lease {
+    memory_budget* budget_{nullptr};
+    std::size_t bytes_{0};
+
+  public:
+    lease() = default;
+
+    lease(memory_budget* budget, std::size_t bytes) noexcept : budget_(budget), bytes_(bytes) {}
+
+    lease(lease&& other) noexcept
+      : budget_(std::exchange(other.budget_, nullptr)), bytes_(std::exchange(other.bytes_, 0)) {}
+
+    lease& operator=(lease&& other) noexcept {
+      if (this != &other) {
+        reset();
+        budget_ = std::exchange(other.budget_, nullptr);
+        bytes_ = std::exchange(other.bytes_, 0);
+      }
+      return *this;
+    }
+
+    lease(const lease&) = delete;
+    lease& operator=(const lease&) = delete;
+
+    ~lease() {
+      reset();
+    }
+
+    /**
+     * @brief Charge the bytes the holder has now instead, e.g. once its output
+     * is there; more bytes are charged without waiting, they are taken already.
+     * @param [in] bytes - bytes held.
+     */
+    void resize(std::size_t bytes) noexcept {
+      if (budget_ == nullptr)
+        return;
+      if (bytes > bytes_)
+        budget_->force_charge(bytes - bytes_);
+      else
+        budget_->release(bytes_ - bytes);
+      bytes_ = bytes;
+    }
+
+    /**
+     * @brief Keep the bytes charged after the lease, e.g. for the records that
+     * stay in memory until the next stage; they are released by "release".
+     * @return Bytes kept.
+     */
+    std::size_t detach() noexcept {
+      if (budget_ == nullptr)
+        return 0;
+      std::size_t res = std::exchange(bytes_, 0);
+      std::exchange(budget_, nullptr)->end_lease();
+      return res;
+    }
+
+    /** @brief Release the bytes. */
+    void reset() noexcept {
+      if (budget_ == nullptr)
+        return;
+      budget_->release(std::exchange(bytes_, 0));
+      std::exchange(budget_, nullptr)->end_lease();
+    }
+
+    std::size_t bytes() const noexcept {
+      return bytes_;
+    }
+  };
+
+  /**
+   * @brief Constructor with param.
+   * @param [in] limit - limit in bytes, zero - no limit.
+   */
+  explicit memory_budget(std::size_t limit = 0) noexcept : limit_(limit) {}
+
+  /**
+   * @brief Set the limit.
+   * @param [in] limit - limit in bytes, zero - no limit.
+   */
+  void set_limit(std::size_t limit) noexcept {
+    limit_ = limit;
+  }
+
+  /**
+   * @brief Charge the bytes if the usage stays within the level.
+   * @param [in] bytes - bytes to charge.
+   * @param [in] level - max usage after the charge, the limit by default.
+   * @return "True" - the bytes are charged, otherwise - "False".
+   */
+  bool try_charge(std::size_t bytes, std::size_t level = 0) noexcept {
+    if (level == 0 || (limit_ != 0 && level > limit_))
+      level = limit_;
+
+    std::size_t used = used_.load();
+    do {
+      if (level != 0 && used + bytes > level)
+        return false;
+    } while (!used_.compare_exchange_weak(used, used + bytes));
+
+    update_peak(used + bytes);
+    return true;
+  }
+
+  /**
+   * @brief Charge the bytes, wait while the usage would exceed the level.
+   * @details For the holders that release their bytes soon, e.g. a batch of a
+   * task until it is spilled: the caller waits until the other leases release
+   * enough. If no other lease is given out, nothing is going to be released,
+   * the bytes are charged over the level then.
+   * @param [in] bytes - bytes to charge.
+   * @param [in] level - max usage after the charge, the limit by default.
+   * @return Lease of the bytes.
+   */
+  lease acquire(std::size_t bytes, std::size_t level = 0) {
+    std::unique_lock<std::mutex> lock(mtx_);
+    ++waiting_;
+    cv_.wait(lock, [&] { return leases_ == 0 || try_charge(bytes, level); });
+    --waiting_;
+    if (leases_++ == 0)
+      force_charge(bytes);
+    return lease(this, bytes);
+  }
+
+  /**
+   * @brief Charge the bytes.
+   * @param [in] bytes - bytes to charge.
+   * @param [in] what - holder of the bytes, for the error message.
+   * @throw memory_limit_error - if the usage would exceed the limit, nothing is charged.
+   */
+  void charge(std::size_t bytes, const std::string& what) {
+    if (try_charge(bytes))
+      return;
+    throw memory_limit_error("Memory limit of " + mib(limit_) + " is exceeded: " + what +
+                             " needs " + mib(bytes) + " more, " + mib(used_.load()) +
+                             " is in use");
+  }
+
+  /**
+   * @brief Release charged bytes.
+   * @param [in] bytes - bytes to release.
+   */
+  void release(std::size_t bytes) noexcept {
+    std::size_t used = used_.load();
+    while (!used_.compare_exchange_weak(used, used > bytes ? used - bytes : 0)) {}
+    wake();
+  }
+
+  /** @brief Forget all charges, e.g. of a job that stopped halfway. */
+  void clear() noexcept {
+    used_ = 0;
+    peak_ = 0;
+  }
+
+  /**
+   * @brief Start a new peak at the current usage.
+   * @return Peak usage before the reset.
+   */
+  std::size_t reset_peak() noexcept {
+    return peak_.exchange(used_.load());
+  }
+
+  std::size_t limit() const noexcept {
+    return limit_;
+  }
+
+  std::size_t used() const noexcept {
+    return used_;
+  }
+
+  std::size_t peak() const noexcept {
+    return peak_;
+  }
+
+private:
+  void force_charge(std::size_t bytes) noexcept {
+    update_peak(used_ += bytes);
+  }
+
+  void end_lease() noexcept {
+    std::lock_guard<std::mutex> lock(mtx_);
+    --leases_;
+    cv_.notify_all();
+  }
+
+  /** @brief Let the waiting holders look at the usage again. */
+  void wake() noexcept {
+    if (waiting_.load() != 0) {
+      std::lock_guard<std::mutex> lock(mtx_);
+      cv_.notify_all();
+    }
+  }
+
+  void update_peak(std::size_t used) noexcept {
+    std::size_t peak = peak_.load();
+    while (peak < used && !peak_.compare_exchange_weak(peak, used)) {}
+  }
+
+  static std::string mib(std::size_t bytes) {
+    return std::to_string((bytes + (1 << 20) - 1) >> 20) + " MiB";
+  }
+};
+
+} /* common:: */
+
+#endif /* COMMON_MEMORY_BUDGET_HPP_ */
@@ -9,9 +9,15 @@
 #ifndef COMMON_MERGE_HPP_
 #define COMMON_MERGE_HPP_
 
+#include <algorithm>
+#include <cmath>
 #include <queue>
+#include <utility>
+#include <vector>
 
 #include "extractor.hpp"
+#include "loser_tree.hpp"
+#include "split.hpp"
 
 /** @brief The namespace of the Common */
 namespace common {
@@ -50,6 +56,161 @@ std::vector<T> merge(std::vector<std::vector<T>>&& data) {
   return res;
 }
 
+/**
+ * @brief Cut sorted runs into disjoint key ranges.
+ *
+ * @details
+ * Splitters are picked from a regular sample of every run. Every sampled
+ * element stands for the elements of its run up to the next sample and is
+ * weighted by their estimated cost ("record_weight"), so the ranges hold
+ * about the same amount of work, not of elements. Every run is cut by binary
+ * search for each splitter; the elements equal to a splitter always go to the
+ * same range, so a key never spans two ranges.
+ *
+ * With "spread", a key whose elements alone outweigh a range is given several
+ * ranges of its own and its elements are shared out evenly between them; such
+ * ranges must be combined after the merge (the last element of a range equals
+ * the first element of the next one).
+ *
+ * The ranges can be merged independently and concatenated in order.
+ *
+ * @param [in] data - sorted runs.
+ * @param [in] parts - a given number of ranges.
+ * @param [in] spread - may the elements of one key span several ranges.
+ * @return For every non-empty range the slices of the runs that fall into it.
+ */
+template <class T>
+std::vector<std::vector<std::vector<T>>> split_runs(std::vector<std::vector<T>>&& data,
+                                                    std::size_t parts, bool spread = false) {
+  /* sample of (element, weight) */
+  const std::size_t oversampling = 16;
+  std::vector<std::pair<const T*, double>> sample;
+  double total = 0;
+  for (const std::vector<T>& run : data) {
+    if (run.empty())
+      continue;
+
+    std::size_t count = std::min(run.size(), parts * oversampling);
+    double share = static_cast<double>(run.size()) / static_cast<double>(count);
+    for (std::size_t i = 0; i != count; ++i) {
+      const T& elem = run[i * run.size() / count];
+      double weight = share * static_cast<double>(record_weight(elem));
+      sample.emplace_back(&elem, weight);
+      total += weight;
+    }
+  }
+  std::sort(sample.begin(), sample.end(),
+            [](const auto& lhs, const auto& rhs) { return *lhs.first < *rhs.first; });
+
+  /* pick cuts at the quantiles of the weighted sample: a key and the share of
+     its elements that go before the cut */
+  const double target = total / static_cast<double>(parts);
+  std::vector<std::pair<const T*, double>> cuts;
+  double acc = 0;
+  for (std::size_t i = 0; i != sample.size();) {
+    const T* key = sample[i].first;
+    double group = 0;
+    for (; i != sample.size() && !(*key < *sample[i].first); ++i)
+      group += sample[i].second;
+    double before = acc;
+    acc += group;
+
+    if (spread && group > target) {
+      /* no cut at the start of the key if nothing is before it */
+      auto pieces = static_cast<std::size_t>(std::ceil(group / target));
+      for (std::size_t p = before > 0 ? 0 : 1; p != pieces && cuts.size() + 1 < parts; ++p)
+        cuts.emplace_back(key, static_cast<double>(p) / static_cast<double>(pieces));
+      continue;
+    }
+
+    double bound = total * static_cast<double>(cuts.size() + 1) / static_cast<double>(parts);
+    if (cuts.size() + 1 < parts && acc >= bound)
+      cuts.emplace_back(key, 0.0);
+  }
+
+  /* cut every run, the cuts point into the runs, so cut before moving */
+  std::vector<std::vector<std::size_t>> bounds;
+  for (const std::vector<T>& run : data) {
+    std::vector<std::size_t> pos{0};
+    for (const auto& [key, share] : cuts) {
+      auto first = run.begin() + pos.back();
+      auto it = std::lower_bound(first, run.end(), *key);
+      if (share > 0) {
+        auto range = std::equal_range(run.begin(), run.end(), *key);
+        auto size = static_cast<double>(std::distance(range.first, range.second));
+        it = std::max(first, range.first + static_cast<std::ptrdiff_t>(size * share));
+      }
+      pos.push_back(static_cast<std::size_t>(std::distance(run.begin(), it)));
+    }
+    pos.push_back(run.size());
+    bounds.push_back(std::move(pos));
+  }
+
+  std::vector<std::vector<std::vector<T>>> res(cuts.size() + 1);
+  for (std::size_t r = 0; r != data.size(); ++r) {
+    for (std::size_t p = 0; p != res.size(); ++p) {
+      auto first = data[r].begin() + bounds[r][p];
+      auto last = data[r].begin() + bounds[r][p + 1];
+      if (first != last)
+        res[p].emplace_back(std::make_move_iterator(first), std::make_move_iterator(last));
+    }
+  }
+  res.erase(std::remove_if(res.begin(), res.end(),
+                           [](const std::vector<std::vector<T>>& vec) { return vec.empty(); }),
+            res.end());
+
+  return res;
+}
+
+/**
+ * @brief Combine sorted vectors into one big one with a loser tree.
+ *
+ * @details
+ * The same result as "merge", but the cursors stay in place and every element
+ * costs about log2(k) comparisons instead of a heap pop and push of the whole
+ * extractor.
+ *
+ * @param [in] data - input data.
+ * @return Vector.
+ */
+template <class T>
+std::vector<T> merge_tournament(std::vector<std::vector<T>>&& data) {
+  std::size_t count = 0;
+  std::vector<common::extractor<T>> sources;
+  sources.reserve(data.size());
+  for (std::vector<T>& vec : data) {
+    count += vec.size();
+    sources.emplace_back(std::move(vec));
+  }
+
+  std::vector<T> res;
+  res.reserve(count);
+
+  loser_tree<common::extractor<T>> tree(std::move(sources));
+  while (tree.has_next())
+    res.push_back(tree.extract());
+
+  return res;
+}
+
+/**
+ * @brief Merge sorted sources into a sink, one element at a time.
+ *
+ * @details
+ * Sources have the interface of "common::extractor" ("has_next", "val",
+ * "extract"), so in-memory and on-disk runs can be merged together. Nothing
+ * but the sources themselves is kept in memory.
+ *
+ * @param [in] sources - sorted sources.
+ * @param [in] sink - callable, receives the elements in sorted order.
+ */
+template <class Source, class Sink>
+void merge_stream(std::vector<Source>&& sources, Sink&& sink) {
+  loser_tree<Source> tree(std::move(sources));
+  while (tree.has_next())
+    sink(tree.extract());
+}
+
 } /* common:: */
 
 #endif /* COMMON_MERGE_HPP_ */
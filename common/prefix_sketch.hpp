@@ -0,0 +1,360 @@
+/**
+ * @file prefix_sketch.hpp
+ * @brief Definition of the fixed-memory sketches of the prefix frequencies.
+ *
+ * @author Maxim <john.jasper.doe@gmail.com>
+ * @date 2020
+ */
+
+#ifndef COMMON_PREFIX_SKETCH_HPP_
+#define COMMON_PREFIX_SKETCH_HPP_
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/** @brief The namespace of the Common */
+namespace common {
+
+/**
+ * @brief Class "Space Saving".
+ *
+ * @details
+ * Summary of the most frequent keys of a stream in "capacity" counters
+ * (Metwally et al.). A counter of a key that is not monitored replaces the
+ * smallest counter and inherits its count as the error. So for every
+ * monitored key "count - error <= true count <= count", and a key that is not
+ * monitored occurs at most "bound()" times. Summaries are merged by adding
+ * the counts, the bounds stay valid.
+ */
+class space_saving {
+public:
+  /** @brief Counter of a key. */
+  struct entry {
+    std::uint64_t key;
+    std::uint64_t count;
+    std::uint64_t error;
+  };
+
+private:
+  std::size_t capacity_;
+  /** @brief Min-heap of the counters by count. */
+  std::vector<entry> heap_;
+  /** @brief Position of the key in the heap. */
+  std::unordered_map<std::uint64_t, std::size_t> pos_;
+  /** @brief Max count of the keys dropped by merges. */
+  std::uint64_t floor_{0};
+
+public:
+  /**
+   * @brief Constructor with param.
+   * @param [in] capacity - number of counters.
+   */
+  explicit space_saving(std::size_t capacity) : capacity_(std::max<std::size_t>(capacity, 1)) {
+    heap_.reserve(capacity_);
+    pos_.reserve(capacity_);
+  }
+
+  /**
+   * @brief Add occurrences of the key.
+   * @param [in] key - key.
+   * @param [in] count - number of occurrences.
+   */
+  void add(std::uint64_t key, std::uint64_t count = 1) {
+    auto it = pos_.find(key);
+    if (it != pos_.end()) {
+      heap_[it->second].count += count;
+      sift_down(it->second);
+      return;
+    }
+
+    std::uint64_t base = bound();
+    if (heap_.size() < capacity_) {
+      heap_.push_back(entry{key, base + count, base});
+      pos_[key] = heap_.size() - 1;
+      sift_up(heap_.size() - 1);
+      return;
+    }
+
+    pos_.erase(heap_.front().key);
+    floor_ = std::max(floor_, heap_.front().count);
+    heap_.front() = entry{key, base + count, base};
+    pos_[key] = 0;
+    sift_down(0);
+  }
+
+  /**
+   * @brief Merge the other summary in.
+   * @param [in] other - summary of another part of the stream.
+   */
+  void merge(const space_saving& other) {
+    std::uint64_t own_bound = bound();
+    std::uint64_t other_bound = other.bound();
+
+    std::vector<entry> all;
+    all.reserve(heap_.size() + other.heap_.size());
+    for (const entry& e : heap_) {
+      auto it = other.pos_.find(e.key);
+      if (it != other.pos_.end()) {
+        const entry& o = other.heap_[it->second];
+        all.push_back(entry{e.key, e.count + o.count, e.error + o.error});
+      }
+      else
+        all.push_back(entry{e.key, e.count + other_bound, e.error + other_bound});
+    }
+    for (const entry& o : other.heap_) {
+      if (pos_.find(o.key) == pos_.end())
+        all.push_back(entry{o.key, o.count + own_bound, o.error + own_bound});
+    }
+
+    /* keep the largest counters, a key monitored by neither occurs at most the sum of bounds */
+    floor_ = own_bound + other_bound;
+    if (all.size() > capacity_) {
+      std::nth_element(all.begin(), all.begin() + static_cast<std::ptrdiff_t>(capacity_),
+                       all.end(),
+                       [](const entry& lhs, const entry& rhs) { return lhs.count > rhs.count; });
+      for (auto it = all.begin() + static_cast<std::ptrdiff_t>(capacity_); it != all.end(); ++it)
+        floor_ = std::max(floor_, it->count);
+      all.resize(capacity_);
+    }
+
+    heap_ = std::move(all);
+    std::make_heap(heap_.begin(), heap_.end(), greater);
+    pos_.clear();
+    for (std::size_t i = 0; i != heap_.size(); ++i)
+      pos_[heap_[i].key] = i;
+  }
+
+  /**
+   * @brief Get the max number of occurrences of a key that is not monitored.
+   * @return Bound.
+   */
+  std::uint64_t bound() const noexcept {
+    return heap_.size() < capacity_ ? floor_ : std::max(floor_, heap_.front().count);
+  }
+
+  /**
+   * @brief Get the counters.
+   * @return Counters in no particular order.
+   */
+  const std::vector<entry>& entries() const noexcept {
+    return heap_;
+  }
+
+  /**
+   * @brief Get the number of counters.
+   * @return Capacity.
+   */
+  std::size_t capacity() const noexcept {
+    return capacity_;
+  }
+
+  /**
+   * @brief Restore a summary from its parts, e.g. read from a file.
+   * @param [in] capacity - number of counters.
+   * @param [in] entries - counters.
+   * @param [in] floor - max count of the keys dropped by merges.
+   * @return Summary.
+   */
+  static space_saving restore(std::size_t capacity, std::vector<entry>&& entries,
+                              std::uint64_t floor) {
+    /* nothing is reserved by the capacity, it may be read from a damaged file */
+    space_saving res(1);
+    res.capacity_ = std::max<std::size_t>(capacity, 1);
+    res.heap_ = std::move(entries);
+    res.pos_.reserve(res.heap_.size());
+    res.floor_ = floor;
+    std::make_heap(res.heap_.begin(), res.heap_.end(), greater);
+    for (std::size_t i = 0; i != res.heap_.size(); ++i)
+      res.pos_[res.heap_[i].key] = i;
+    return res;
+  }
+
+  /**
+   * @brief Get the max count of the keys dropped by merges.
+   * @return Count.
+   */
+  std::uint64_t floor() const noexcept {
+    return floor_;
+  }
+
+private:
+  /** @brief Order of "std::make_heap" for a min-heap. */
+  static bool greater(const entry& lhs, const entry& rhs) noexcept {
+    return lhs.count > rhs.count;
+  }
+
+  void swap_entries(std::size_t lhs, std::size_t rhs) {
+    std::swap(heap_[lhs], heap_[rhs]);
+    pos_[heap_[lhs].key] = lhs;
+    pos_[heap_[rhs].key] = rhs;
+  }
+
+  void sift_up(std::size_t idx) {
+    while (idx != 0) {
+      std::size_t parent = (idx - 1) / 2;
+      if (heap_[parent].count <= heap_[idx].count)
+        return;
+      swap_entries(parent, idx);
+      idx = parent;
+    }
+  }
+
+  void sift_down(std::size_t idx) {
+    for (;;) {
+      std::size_t least = idx;
+      for (std::size_t child = 2 * idx + 1; child <= 2 * idx + 2 && child < heap_.size(); ++child) {
+        if (heap_[child].count < heap_[least].count)
+          least = child;
+      }
+      if (least == idx)
+        return;
+      swap_entries(idx, least);
+      idx = least;
+    }
+  }
+};
+
+/** @brief Estimate of the minimal identifying prefix size. */
+struct prefix_estimate {
+  /** @brief Estimated size, a size the exact answer is at least. */
+  std::size_t size;
+  /** @brief The exact size is in [lower, upper]. */
+  std::size_t lower;
+  std::size_t upper;
+};
+
+/**
+ * @brief Class "Prefix Sketch".
+ *
+ * @details
+ * One "space_saving" summary of the prefixes of every length up to
+ * "max_len", the prefixes are kept as 64-bit hashes. The memory of the
+ * sketch is fixed by "max_len * capacity" counters whatever the input is.
+ * A length has a shared prefix for sure when a counter of it has
+ * "count - error > 1", and may have one when a counter or the bound of not
+ * monitored keys is greater than one.
+ */
+class prefix_sketch {
+  std::vector<space_saving> lengths_;
+  /** @brief Size of the longest record. */
+  std::size_t longest_{0};
+
+public:
+  /**
+   * @brief Constructor with param.
+   * @param [in] max_len - longest prefix tracked.
+   * @param [in] capacity - counters per prefix length.
+   */
+  prefix_sketch(std::size_t max_len, std::size_t capacity)
+    : lengths_(std::max<std::size_t>(max_len, 1), space_saving(capacity)) {}
+
+  /**
+   * @brief Constructor with param, e.g. for a sketch read from a file.
+   * @param [in] lengths - summaries of the prefix lengths.
+   * @param [in] longest - size of the longest record.
+   */
+  prefix_sketch(std::vector<space_saving>&& lengths, std::size_t longest)
+    : lengths_(std::move(lengths)), longest_(longest) {}
+
+  /**
+   * @brief Add the prefixes of the record.
+   * @param [in] str - record.
+   */
+  void insert(std::string_view str) {
+    longest_ = std::max(longest_, str.size());
+
+    /* FNV-1a of the prefix grows byte by byte */
+    std::uint64_t hash = 14695981039346656037ull;
+    std::size_t len = std::min(str.size(), lengths_.size());
+    for (std::size_t i = 0; i != len; ++i) {
+      hash = (hash ^ static_cast<unsigned char>(str[i])) * 1099511628211ull;
+      lengths_[i].add(hash);
+    }
+  }
+
+  /**
+   * @brief Merge the other sketch in.
+   * @param [in] other - sketch of another part of the input.
+   */
+  void merge(const prefix_sketch& other) {
+    longest_ = std::max(longest_, other.longest_);
+    std::size_t len = std::min(lengths_.size(), other.lengths_.size());
+    for (std::size_t i = 0; i != len; ++i)
+      lengths_[i].merge(other.lengths_[i]);
+  }
+
+  /**
+   * @brief Estimate the minimal identifying prefix size.
+   * @return Estimate and bounds of the exact size.
+   */
+  prefix_estimate estimate() const noexcept {
+    std::size_t sure = 0;
+    std::size_t maybe = 0;
+    for (std::size_t i = 0; i != lengths_.size(); ++i) {
+      const space_saving& len = lengths_[i];
+      bool shared = false;
+      bool may_share = len.bound() > 1;
+      for (const space_saving::entry& e : len.entries()) {
+        shared = shared || e.count - e.error > 1;
+        may_share = may_share || e.count > 1;
+      }
+      if (shared)
+        sure = i + 1;
+      if (may_share)
+        maybe = i + 1;
+    }
+
+    /* longer prefixes are not tracked, they may be shared up to the longest record */
+    if (maybe == lengths_.size())
+      maybe = std::max(maybe, longest_);
+    return prefix_estimate{sure + 1, sure + 1, std::max(sure, maybe) + 1};
+  }
+
+  /**
+   * @brief Get the summaries of the prefix lengths.
+   * @return Summaries, the first one is of the prefixes of one byte.
+   */
+  const std::vector<space_saving>& lengths() const noexcept {
+    return lengths_;
+  }
+
+  /**
+   * @brief Get the size of the longest record.
+   * @return Size.
+   */
+  std::size_t longest() const noexcept {
+    return longest_;
+  }
+};
+
+/** @brief All sketches are of one key, so the sketches of a job meet in one reducer. */
+inline bool operator<(const prefix_sketch&, const prefix_sketch&) noexcept {
+  return false;
+}
+inline bool operator==(const prefix_sketch&, const prefix_sketch&) noexcept {
+  return true;
+}
+inline bool operator!=(const prefix_sketch&, const prefix_sketch&) noexcept {
+  return false;
+}
+
+} /* common:: */
+
+namespace std {
+
+/** @brief Hash of the sketch, all sketches are of one key. */
+template <>
+struct hash<common::prefix_sketch> {
+  std::size_t operator()(const common::prefix_sketch&) const noexcept {
+    return 0;
+  }
+};
+
+} /* std:: */
+
+#endif /* COMMON_PREFIX_SKETCH_HPP_ */
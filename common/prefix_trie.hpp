@@ -0,0 +1,217 @@
+/**
+ * @file prefix_trie.hpp
+ * @brief Definition of the class "Prefix Trie".
+ *
+ * @author Maxim <john.jasper.doe@gmail.com>
+ * @date 2020
+ */
+
+#ifndef COMMON_PREFIX_TRIE_HPP_
+#define COMMON_PREFIX_TRIE_HPP_
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/** @brief The namespace of the Common */
+namespace common {
+
+/**
+ * @brief Class "Prefix Trie".
+ *
+ * @details
+ * The trie holds words that start with the same first byte (the key of the
+ * trie). Every node keeps the number of words passing through it, so the
+ * count of a node is the number of words sharing the prefix that ends in the
+ * node. Nodes are stored in one vector and linked by indices, children of a
+ * node are kept sorted by label.
+ */
+class prefix_trie {
+public:
+  /** @brief Node of the trie. */
+  struct node {
+    std::uint64_t count;
+    std::uint32_t child;
+    std::uint32_t sibling;
+    unsigned char label;
+  };
+
+private:
+  /** @brief Index of the "no node" link. */
+  static constexpr std::uint32_t npos = 0;
+
+  /** @brief Nodes, the first one is the root and holds the key. */
+  std::vector<node> nodes_;
+
+public:
+  /**
+   * @brief Constructor with param.
+   * @param [in] key - first byte of every word of the trie.
+   */
+  explicit prefix_trie(unsigned char key) : nodes_{node{0, npos, npos, key}} {}
+
+  /**
+   * @brief Constructor with param.
+   * @param [in] nodes - nodes of a trie, e.g. read back from a file.
+   */
+  explicit prefix_trie(std::vector<node>&& nodes) : nodes_(std::move(nodes)) {}
+
+  prefix_trie(prefix_trie&&) = default;
+  prefix_trie& operator=(prefix_trie&&) = default;
+
+  /**
+   * @brief Get the key of the trie.
+   * @return First byte of every word.
+   */
+  unsigned char key() const noexcept {
+    return nodes_[0].label;
+  }
+
+  /**
+   * @brief Get number of words in the trie.
+   * @return Number of words.
+   */
+  std::uint64_t count() const noexcept {
+    return nodes_[0].count;
+  }
+
+  /**
+   * @brief Get number of nodes in the trie.
+   * @return Number of nodes.
+   */
+  std::size_t size() const noexcept {
+    return nodes_.size();
+  }
+
+  /**
+   * @brief Get nodes of the trie.
+   * @return Nodes, the first one is the root.
+   */
+  const std::vector<node>& nodes() const noexcept {
+    return nodes_;
+  }
+
+  /**
+   * @brief Add a word.
+   * @param [in] word - word, must start with the key of the trie.
+   */
+  void insert(std::string_view word) {
+    std::uint32_t cur = 0;
+    nodes_[cur].count += 1;
+    for (std::size_t i = 1; i < word.size(); ++i) {
+      cur = child(cur, static_cast<unsigned char>(word[i]));
+      nodes_[cur].count += 1;
+    }
+  }
+
+  /**
+   * @brief Add all words of another trie with the same key.
+   * @param [in] other - trie to merge in.
+   */
+  void merge(const prefix_trie& other) {
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> stack{{0, 0}};
+    while (!stack.empty()) {
+      auto [dst, src] = stack.back();
+      stack.pop_back();
+
+      nodes_[dst].count += other.nodes_[src].count;
+      for (std::uint32_t c = other.nodes_[src].child; c != npos; c = other.nodes_[c].sibling) {
+        std::uint32_t dst_child = child(dst, other.nodes_[c].label);
+        stack.emplace_back(dst_child, c);
+      }
+    }
+  }
+
+  /**
+   * @brief Find the deepest prefix shared by more than one word.
+   * @details If no prefix is shared, the longest word is returned.
+   * @return Prefix and number of words sharing it.
+   */
+  std::pair<std::string, std::uint64_t> deepest_shared() const {
+    std::string best(1, static_cast<char>(key()));
+    std::uint64_t best_count = nodes_[0].count;
+
+    /* (node, depth) pairs, "path" holds the labels from the root */
+    std::string path;
+    std::vector<std::pair<std::uint32_t, std::size_t>> stack{{0, 0}};
+    while (!stack.empty()) {
+      auto [cur, depth] = stack.back();
+      stack.pop_back();
+
+      path.resize(depth);
+      path.push_back(static_cast<char>(nodes_[cur].label));
+
+      const node& n = nodes_[cur];
+      bool shared = n.count > 1;
+      bool best_shared = best_count > 1;
+      if ((shared && !best_shared) || (shared == best_shared && path.size() > best.size())) {
+        best = path;
+        best_count = n.count;
+      }
+
+      /* push children in reverse order to visit them sorted */
+      std::size_t first = stack.size();
+      for (std::uint32_t c = n.child; c != npos; c = nodes_[c].sibling)
+        stack.emplace_back(c, depth + 1);
+      std::reverse(stack.begin() + first, stack.end());
+    }
+
+    return {std::move(best), best_count};
+  }
+
+private:
+  /**
+   * @brief Find or create the child of the node.
+   * @param [in] parent - index of the node.
+   * @param [in] label - label of the child.
+   * @return Index of the child.
+   */
+  std::uint32_t child(std::uint32_t parent, unsigned char label) {
+    std::uint32_t prev = npos;
+    std::uint32_t cur = nodes_[parent].child;
+    while (cur != npos && nodes_[cur].label < label) {
+      prev = cur;
+      cur = nodes_[cur].sibling;
+    }
+    if (cur != npos && nodes_[cur].label == label)
+      return cur;
+
+    auto idx = static_cast<std::uint32_t>(nodes_.size());
+    nodes_.push_back(node{0, npos, cur, label});
+    if (prev == npos)
+      nodes_[parent].child = idx;
+    else
+      nodes_[prev].sibling = idx;
+    return idx;
+  }
+};
+
+inline bool operator<(const prefix_trie& lhs, const prefix_trie& rhs) {
+  return lhs.key() < rhs.key();
+}
+inline bool operator==(const prefix_trie& lhs, const prefix_trie& rhs) {
+  return lhs.key() == rhs.key();
+}
+inline bool operator!=(const prefix_trie& lhs, const prefix_trie& rhs) {
+  return !(lhs == rhs);
+}
+
+} /* common:: */
+
+namespace std {
+
+/** @brief Hash of the trie is the hash of its key. */
+template <>
+struct hash<common::prefix_trie> {
+  std::size_t operator()(const common::prefix_trie& obj) const noexcept {
+    return std::hash<unsigned char>{}(obj.key());
+  }
+};
+
+} /* std:: */
+
+#endif /* COMMON_PREFIX_TRIE_HPP_ */
@@ -0,0 +1,300 @@
+/**
+ * @file run_codec.hpp
+ * @brief Definition of the encoders and decoders of the run files.
+ *
+ * @author Maxim <john.jasper.doe@gmail.com>
+ * @date 2020
+ */
+
+#ifndef COMMON_RUN_CODEC_HPP_
+#define COMMON_RUN_CODEC_HPP_
+
+#include <algorithm>
+#include <cstdint>
+#include <istream>
+#include <optional>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#include "arena.hpp"
+#include "counter.hpp"
+#include "prefix_trie.hpp"
+
+#include "serializer.hpp"
+
+/** @brief The namespace of the Common */
+namespace common {
+
+/** @brief Internal namespace. */
+namespace _detail {
+
+/**
+ * @brief Write the end of a run, a block without records.
+ * @details A run file that is cut after a whole block still misses its end,
+ * so it is not taken for a shorter run.
+ */
+inline void write_run_end(std::ostream& os) {
+  write_block(os, 0, std::string());
+}
+
+/**
+ * @brief Read the next block of a run file.
+ * @return "True" - the block is read, "False" - the end of the run is reached.
+ * @throw std::runtime_error - if the file is over before the end of the run or
+ * the block is damaged.
+ */
+inline bool read_run_block(std::istream& is, std::uint64_t& count, std::string& payload) {
+  if (!read_block(is, count, payload))
+    throw std::runtime_error("Truncated run, its end is missing");
+  if (count == 0 && !payload.empty())
+    throw std::runtime_error("Corrupted end of run");
+  return count != 0;
+}
+
+} /* _detail:: */
+
+/**
+ * @brief Template class "Run Encoder", writes the records of a run file.
+ * @details Records are written by the serializer of the type into checked
+ * blocks (see "_detail::write_block") of about "block_size" bytes.
+ */
+template <class T>
+class run_encoder {
+  /** @brief Payload bytes of a block. */
+  static constexpr std::size_t block_size = 64 << 10;
+
+  std::ostringstream block_;
+  std::size_t count_{0};
+
+public:
+  void write(std::ostream& os, const T& obj) {
+    serializer<T>::write(block_, obj);
+    ++count_;
+
+    if (static_cast<std::size_t>(block_.tellp()) >= block_size)
+      flush(os);
+  }
+
+  /** @brief Write the current block. */
+  void flush(std::ostream& os) {
+    if (count_ == 0)
+      return;
+
+    _detail::write_block(os, count_, block_.str());
+    block_.str(std::string());
+    count_ = 0;
+  }
+};
+
+/**
+ * @brief Template class "Run Decoder", reads the records of a run file.
+ * @details Counterpart of "run_encoder", the block is checked before its
+ * first record is returned.
+ */
+template <class T>
+class run_decoder {
+  std::istringstream block_;
+  std::string payload_;
+  std::uint64_t left_{0};
+  bool end_{false};
+
+public:
+  /**
+   * @brief Read the next record.
+   * @param [in] is - input stream.
+   * @param [in] arena - arena for the data of the records.
+   * @return Record, empty if the run is over.
+   * @throw std::runtime_error - if the data is truncated or corrupted.
+   */
+  std::optional<T> read(std::istream& is, string_arena& arena) {
+    if (left_ == 0 && !read_block(is))
+      return std::nullopt;
+
+    std::optional<T> res = serializer<T>::read(block_, arena);
+    if (!res)
+      throw std::runtime_error("Corrupted record in run block");
+    if (--left_ == 0 && !_detail::at_end(block_))
+      throw std::runtime_error("Corrupted run block");
+    return res;
+  }
+
+private:
+  bool read_block(std::istream& is) {
+    std::uint64_t count = 0;
+    if (end_ || !_detail::read_run_block(is, count, payload_)) {
+      end_ = true;
+      return false;
+    }
+
+    block_.clear();
+    block_.str(payload_);
+    left_ = count;
+    return true;
+  }
+};
+
+/**
+ * @brief Run encoder of the prefix tries.
+ * @details A trie is a checked block itself (see "serializer<prefix_trie>"),
+ * it is not wrapped into one more.
+ */
+template <>
+class run_encoder<prefix_trie> {
+public:
+  void write(std::ostream& os, const prefix_trie& obj) {
+    serializer<prefix_trie>::write(os, obj);
+  }
+
+  /** @brief Write the buffered records, nothing is buffered here. */
+  void flush(std::ostream&) {}
+};
+
+/**
+ * @brief Run decoder of the prefix tries.
+ * @details Counterpart of "run_encoder<prefix_trie>".
+ */
+template <>
+class run_decoder<prefix_trie> {
+  std::string payload_;
+  bool end_{false};
+
+public:
+  /**
+   * @brief Read the next trie.
+   * @return Trie, empty if the run is over.
+   * @throw std::runtime_error - if the data is truncated or corrupted.
+   */
+  std::optional<prefix_trie> read(std::istream& is, string_arena&) {
+    std::uint64_t count = 0;
+    if (end_ || !_detail::read_run_block(is, count, payload_)) {
+      end_ = true;
+      return std::nullopt;
+    }
+    return serializer<prefix_trie>::parse(count, payload_);
+  }
+};
+
+/**
+ * @brief Run encoder of the counters of a string, front-coded blocks.
+ *
+ * @details
+ * Sorted keys share most of their bytes with the previous key, so a key is
+ * stored as the length of the prefix shared with the previous key and the
+ * rest of its bytes. The records are grouped into checked blocks (see
+ * "_detail::write_block") of about "block_size" bytes, the payload holds per
+ * record varint shared length, varint suffix length, suffix bytes, varint
+ * count. The first key of a block shares nothing, so every block is decoded
+ * alone.
+ */
+template <class K>
+class run_encoder<counter<K>> {
+  /** @brief Payload bytes of a block. */
+  static constexpr std::size_t block_size = 64 << 10;
+
+  std::string block_;
+  std::string prev_;
+  std::size_t count_{0};
+
+public:
+  void write(std::ostream& os, const counter<K>& obj) {
+    std::string_view key = obj.key();
+    std::size_t shared = 0;
+    if (count_ != 0) {
+      std::size_t max = std::min(key.size(), prev_.size());
+      while (shared != max && key[shared] == prev_[shared])
+        ++shared;
+    }
+
+    _detail::put_varint(block_, shared);
+    _detail::put_varint(block_, key.size() - shared);
+    block_.append(key.substr(shared));
+    _detail::put_varint(block_, obj.count());
+    prev_.assign(key);
+    ++count_;
+
+    if (block_.size() >= block_size)
+      flush(os);
+  }
+
+  /** @brief Write the current block. */
+  void flush(std::ostream& os) {
+    if (count_ == 0)
+      return;
+
+    _detail::write_block(os, count_, block_);
+    block_.clear();
+    count_ = 0;
+  }
+};
+
+/**
+ * @brief Run decoder of the counters of a string, front-coded blocks.
+ * @details The block is checked before its first record is returned.
+ * "std::string_view" keys are placed in the arena.
+ */
+template <class K>
+class run_decoder<counter<K>> {
+  std::string block_;
+  std::size_t pos_{0};
+  std::uint64_t left_{0};
+  std::string prev_;
+  bool end_{false};
+
+public:
+  /**
+   * @brief Read the next record.
+   * @param [in] is - input stream.
+   * @param [in] arena - arena for the "std::string_view" keys.
+   * @return Record, empty if the run is over.
+   * @throw std::runtime_error - if the data is truncated or corrupted.
+   */
+  std::optional<counter<K>> read(std::istream& is, string_arena& arena) {
+    if (left_ == 0 && !read_block(is))
+      return std::nullopt;
+
+    std::uint64_t shared = 0;
+    std::uint64_t len = 0;
+    std::uint64_t count = 0;
+    if (!_detail::get_varint(block_, pos_, shared) || !_detail::get_varint(block_, pos_, len) ||
+        shared > prev_.size() || len > block_.size() - pos_)
+      throw std::runtime_error("Corrupted record in run block");
+    prev_.resize(shared);
+    prev_.append(block_, pos_, len);
+    pos_ += len;
+    if (!_detail::get_varint(block_, pos_, count))
+      throw std::runtime_error("Corrupted record in run block");
+    /* the last record of a block must end its payload */
+    if (--left_ == 0 && pos_ != block_.size())
+      throw std::runtime_error("Corrupted run block");
+
+    if constexpr (std::is_same_v<K, std::string_view>) {
+      char* dst = arena.allocate(prev_.size());
+      prev_.copy(dst, prev_.size());
+      return counter<K>(std::string_view(dst, prev_.size()), count);
+    }
+    else
+      return counter<K>(K(prev_), count);
+  }
+
+private:
+  bool read_block(std::istream& is) {
+    std::uint64_t count = 0;
+    if (end_ || !_detail::read_run_block(is, count, block_)) {
+      end_ = true;
+      return false;
+    }
+
+    pos_ = 0;
+    left_ = count;
+    prev_.clear();
+    return true;
+  }
+};
+
+} /* common:: */
+
+#endif /* COMMON_RUN_CODEC_HPP_ */
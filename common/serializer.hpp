@@ -0,0 +1,469 @@
+/**
+ * @file serializer.hpp
+ * @brief Definition of the binary serializers of the records.
+ *
+ * @author Maxim <john.jasper.doe@gmail.com>
+ * @date 2020
+ */
+
+#ifndef COMMON_SERIALIZER_HPP_
+#define COMMON_SERIALIZER_HPP_
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <istream>
+#include <optional>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "arena.hpp"
+#include "counter.hpp"
+#include "prefix_sketch.hpp"
+#include "prefix_trie.hpp"
+
+/** @brief The namespace of the Common */
+namespace common {
+
+/**
+ * @brief Binary serializer of the record type.
+ *
+ * @details
+ * Every specialization provides:
+ * - "write(os, obj)" - writes the record to a binary stream;
+ * - "read(is, arena)" - reads the next record, empty if the stream is over
+ *   before it, throws "std::runtime_error" if it is over in the middle of the
+ *   record; records that view their data keep it in the arena;
+ * - "size(obj)" - size of the record in bytes, used for memory accounting.
+ */
+template <class T>
+struct serializer;
+
+/** @brief Internal namespace. */
+namespace _detail {
+
+inline void write_u64(std::ostream& os, std::uint64_t val) {
+  os.write(reinterpret_cast<const char*>(&val), sizeof(val));
+}
+
+inline bool read_u64(std::istream& is, std::uint64_t& val) {
+  return static_cast<bool>(is.read(reinterpret_cast<char*>(&val), sizeof(val)));
+}
+
+/** @brief Is the stream over before the next record. */
+inline bool at_end(std::istream& is) {
+  return is.peek() == std::char_traits<char>::eof();
+}
+
+/** @brief Read the next 8 bytes of a record that is already started. */
+inline std::uint64_t read_field(std::istream& is, const char* record) {
+  std::uint64_t val = 0;
+  if (!read_u64(is, val))
+    throw std::runtime_error(std::string("Truncated ") + record + " record");
+  return val;
+}
+
+/** @brief CRC-32 (IEEE 802.3) of the bytes. */
+inline std::uint32_t crc32(const char* data, std::size_t size) noexcept {
+  static const std::array<std::uint32_t, 256> table = [] {
+    std::array<std::uint32_t, 256> res{};
+    for (std::uint32_t i = 0; i != res.size(); ++i) {
+      std::uint32_t crc = i;
+      for (int bit = 0; bit != 8; ++bit)
+        crc = (crc >> 1) ^ (crc & 1 ? 0xEDB88320u : 0);
+      res[i] = crc;
+    }
+    return res;
+  }();
+
+  std::uint32_t crc = 0xFFFFFFFFu;
+  for (std::size_t i = 0; i != size; ++i)
+    crc = table[(crc ^ static_cast<unsigned char>(data[i])) & 0xFF] ^ (crc >> 8);
+  return crc ^ 0xFFFFFFFFu;
+}
+
+/** @brief Append LEB128 varint. */
+inline void put_varint(std::string& dst, std::uint64_t val) {
+  while (val >= 0x80) {
+    dst.push_back(static_cast<char>(val | 0x80));
+    val >>= 7;
+  }
+  dst.push_back(static_cast<char>(val));
+}
+
+/** @brief Parse LEB128 varint at the position, the position is moved past it. */
+inline bool get_varint(std::string_view src, std::size_t& pos, std::uint64_t& val) noexcept {
+  val = 0;
+  for (int shift = 0; pos != src.size() && shift < 64; shift += 7) {
+    auto byte = static_cast<unsigned char>(src[pos++]);
+    val |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+    if (!(byte & 0x80))
+      return true;
+  }
+  return false;
+}
+
+/** @brief Read LEB128 varint from the stream, "false" if the stream is over. */
+inline bool read_varint(std::istream& is, std::uint64_t& val) {
+  val = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    char ch = 0;
+    if (!is.get(ch))
+      return false;
+    auto byte = static_cast<unsigned char>(ch);
+    val |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+    if (!(byte & 0x80))
+      return true;
+  }
+  return false;
+}
+
+/**
+ * @brief Write a checked block: varint record count, varint payload size,
+ * CRC-32 of the payload (4 bytes, little-endian), payload.
+ */
+inline void write_block(std::ostream& os, std::uint64_t count, const std::string& payload) {
+  std::string header;
+  put_varint(header, count);
+  put_varint(header, payload.size());
+  std::uint32_t crc = crc32(payload.data(), payload.size());
+  for (int i = 0; i != 4; ++i)
+    header.push_back(static_cast<char>(crc >> (8 * i)));
+
+  os.write(header.data(), static_cast<std::streamsize>(header.size()));
+  os.write(payload.data(), static_cast<std::streamsize>(payload.size()));
+}
+
+/**
+ * @brief Read a block written by "write_block".
+ * @details The payload is read in steps, so a damaged size fails on the end of
+ * the stream instead of allocating it at once.
+ * @return "True" - the block is read, "False" - the stream is over before the block.
+ * @throw std::runtime_error - if the block is truncated or its checksum does not match.
+ */
+inline bool read_block(std::istream& is, std::uint64_t& count, std::string& payload) {
+  if (is.peek() == std::char_traits<char>::eof())
+    return false;
+
+  std::uint64_t size = 0;
+  char crc_bytes[4];
+  if (!read_varint(is, count) || !read_varint(is, size) || !is.read(crc_bytes, sizeof(crc_bytes)))
+    throw std::runtime_error("Truncated block header");
+
+  payload.clear();
+  while (payload.size() != size) {
+    std::size_t pos = payload.size();
+    std::size_t step = static_cast<std::size_t>(std::min<std::uint64_t>(size - pos, 1 << 20));
+    payload.resize(pos + step);
+    if (!is.read(payload.data() + pos, static_cast<std::streamsize>(step)))
+      throw std::runtime_error("Truncated block");
+  }
+
+  std::uint32_t crc = 0;
+  for (int i = 0; i != 4; ++i)
+    crc |= static_cast<std::uint32_t>(static_cast<unsigned char>(crc_bytes[i])) << (8 * i);
+  if (crc != crc32(payload.data(), payload.size()))
+    throw std::runtime_error("Checksum mismatch in block");
+  return true;
+}
+
+} /* _detail:: */
+
+/**
+ * @brief Serializer of the counter of a string: key length, key bytes, count.
+ * @details "std::string_view" keys read back are placed in the arena.
+ */
+template <class K>
+struct serializer<counter<K>> {
+  static void write(std::ostream& os, const counter<K>& obj) {
+    _detail::write_u64(os, obj.key().size());
+    os.write(obj.key().data(), static_cast<std::streamsize>(obj.key().size()));
+    _detail::write_u64(os, obj.count());
+  }
+
+  /**
+   * @brief Read the next counter.
+   * @return Counter, empty if the stream is over.
+   * @throw std::runtime_error - if the record is truncated.
+   */
+  static std::optional<counter<K>> read(std::istream& is, string_arena& arena) {
+    if (_detail::at_end(is))
+      return std::nullopt;
+    std::uint64_t len = _detail::read_field(is, "counter");
+
+    /* the key is read in steps, so a damaged length fails on the end of the stream */
+    std::string key;
+    while (key.size() != len) {
+      std::size_t pos = key.size();
+      std::size_t step = static_cast<std::size_t>(std::min<std::uint64_t>(len - pos, 1 << 20));
+      key.resize(pos + step);
+      if (!is.read(key.data() + pos, static_cast<std::streamsize>(step)))
+        throw std::runtime_error("Truncated counter record");
+    }
+    std::uint64_t count = _detail::read_field(is, "counter");
+
+    if constexpr (std::is_same_v<K, std::string_view>)
+      return counter<K>(arena.intern(key), count);
+    else
+      return counter<K>(std::move(key), count);
+  }
+
+  static std::size_t size(const counter<K>& obj) noexcept {
+    if constexpr (std::is_same_v<K, std::string_view>)
+      return sizeof(obj);
+    else
+      return sizeof(obj) + obj.key().size();
+  }
+
+  /** @brief Bytes "read" places in the arena for the record. */
+  static std::size_t arena_size(const counter<K>& obj) noexcept {
+    return std::is_same_v<K, std::string_view> ? obj.key().size() : 0;
+  }
+};
+
+/**
+ * @brief Serializer of the prefix trie, a checked block (see "_detail::write_block")
+ * of the nodes: per node varint count, varint child, varint sibling, label.
+ * @details The nodes read back must form a trie: every node but the root is
+ * linked once and the children are sorted, so a damaged record throws
+ * instead of sending the trie out of its nodes.
+ */
+template <>
+struct serializer<prefix_trie> {
+  static void write(std::ostream& os, const prefix_trie& obj) {
+    std::string payload;
+    for (const prefix_trie::node& n : obj.nodes()) {
+      _detail::put_varint(payload, n.count);
+      _detail::put_varint(payload, n.child);
+      _detail::put_varint(payload, n.sibling);
+      payload.push_back(static_cast<char>(n.label));
+    }
+    _detail::write_block(os, obj.nodes().size(), payload);
+  }
+
+  /**
+   * @brief Read the next trie.
+   * @return Trie, empty if the stream is over.
+   * @throw std::runtime_error - if the record is truncated or corrupted.
+   */
+  static std::optional<prefix_trie> read(std::istream& is, string_arena&) {
+    std::uint64_t count = 0;
+    std::string payload;
+    if (!_detail::read_block(is, count, payload))
+      return std::nullopt;
+    return parse(count, payload);
+  }
+
+  /**
+   * @brief Get the trie of a checked block.
+   * @param [in] count - number of nodes.
+   * @param [in] payload - payload of the block.
+   * @return Trie.
+   * @throw std::runtime_error - if the nodes do not form a trie.
+   */
+  static prefix_trie parse(std::uint64_t count, const std::string& payload) {
+    /* a node takes at least 4 bytes, the indices are 32-bit */
+    if (count == 0 || count > payload.size() / 4 || count > UINT32_MAX)
+      throw std::runtime_error("Corrupted trie record");
+
+    std::vector<prefix_trie::node> nodes(count);
+    std::size_t pos = 0;
+    for (prefix_trie::node& n : nodes) {
+      std::uint64_t child = 0;
+      std::uint64_t sibling = 0;
+      if (!_detail::get_varint(payload, pos, n.count) ||
+          !_detail::get_varint(payload, pos, child) ||
+          !_detail::get_varint(payload, pos, sibling) || pos == payload.size() ||
+          child >= count || sibling >= count)
+        throw std::runtime_error("Corrupted trie record");
+      n.child = static_cast<std::uint32_t>(child);
+      n.sibling = static_cast<std::uint32_t>(sibling);
+      n.label = static_cast<unsigned char>(payload[pos++]);
+    }
+    if (pos != payload.size() || !is_trie(nodes))
+      throw std::runtime_error("Corrupted trie record");
+
+    return prefix_trie(std::move(nodes));
+  }
+
+  static std::size_t size(const prefix_trie& obj) noexcept {
+    return sizeof(obj) + obj.nodes().size() * sizeof(prefix_trie::node);
+  }
+
+private:
+  /** @brief Is every node but the root linked once, with the children sorted by label. */
+  static bool is_trie(const std::vector<prefix_trie::node>& nodes) {
+    /* the root is never linked, so the index 0 is the "no node" link */
+    if (nodes[0].sibling != 0)
+      return false;
+
+    std::vector<bool> seen(nodes.size());
+    std::vector<std::uint32_t> stack{0};
+    std::size_t visited = 1;
+    while (!stack.empty()) {
+      std::uint32_t cur = stack.back();
+      stack.pop_back();
+      int prev = -1;
+      for (std::uint32_t c = nodes[cur].child; c != 0; c = nodes[c].sibling) {
+        if (seen[c] || nodes[c].label <= prev)
+          return false;
+        seen[c] = true;
+        prev = nodes[c].label;
+        ++visited;
+        stack.push_back(c);
+      }
+    }
+    return visited == nodes.size();
+  }
+};
+
+/**
+ * @brief Serializer of the prefix sketch: longest record, number of lengths, then per
+ * length capacity, floor, number of counters and the counters.
+ */
+template <>
+struct serializer<prefix_sketch> {
+  static void write(std::ostream& os, const prefix_sketch& obj) {
+    _detail::write_u64(os, obj.longest());
+    _detail::write_u64(os, obj.lengths().size());
+    for (const space_saving& len : obj.lengths()) {
+      _detail::write_u64(os, len.capacity());
+      _detail::write_u64(os, len.floor());
+      _detail::write_u64(os, len.entries().size());
+      for (const space_saving::entry& e : len.entries()) {
+        _detail::write_u64(os, e.key);
+        _detail::write_u64(os, e.count);
+        _detail::write_u64(os, e.error);
+      }
+    }
+  }
+
+  /**
+   * @brief Read the next sketch.
+   * @return Sketch, empty if the stream is over.
+   * @throw std::runtime_error - if the record is truncated or corrupted.
+   */
+  static std::optional<prefix_sketch> read(std::istream& is, string_arena&) {
+    if (_detail::at_end(is))
+      return std::nullopt;
+    std::uint64_t longest = _detail::read_field(is, "sketch");
+    std::uint64_t count = _detail::read_field(is, "sketch");
+
+    /* nothing is allocated by the sizes read, a damaged size fails on the end of the stream */
+    std::vector<space_saving> lengths;
+    for (std::uint64_t i = 0; i != count; ++i) {
+      std::uint64_t capacity = _detail::read_field(is, "sketch");
+      std::uint64_t floor = _detail::read_field(is, "sketch");
+      std::uint64_t size = _detail::read_field(is, "sketch");
+      if (size > capacity)
+        throw std::runtime_error("Corrupted sketch record");
+
+      std::vector<space_saving::entry> entries;
+      for (std::uint64_t j = 0; j != size; ++j) {
+        space_saving::entry e{};
+        e.key = _detail::read_field(is, "sketch");
+        e.count = _detail::read_field(is, "sketch");
+        e.error = _detail::read_field(is, "sketch");
+        entries.push_back(e);
+      }
+      lengths.push_back(space_saving::restore(capacity, std::move(entries), floor));
+    }
+    return prefix_sketch(std::move(lengths), longest);
+  }
+
+  static std::size_t size(const prefix_sketch& obj) noexcept {
+    std::size_t res = sizeof(obj);
+    for (const space_saving& len : obj.lengths())
+      res += sizeof(len) + len.capacity() * sizeof(space_saving::entry);
+    return res;
+  }
+};
+
+/** @brief Internal namespace. */
+namespace _detail {
+
+template <class T, class = void>
+struct has_serializer : std::false_type {};
+
+template <class T>
+struct has_serializer<T, std::void_t<decltype(serializer<T>::size(std::declval<const T&>()))>>
+  : std::true_type {};
+
+template <class T, class = void>
+struct has_arena_size : std::false_type {};
+
+template <class T>
+struct has_arena_size<
+    T, std::void_t<decltype(serializer<T>::arena_size(std::declval<const T&>()))>>
+  : std::true_type {};
+
+} /* _detail:: */
+
+/** @brief Can the records be written to and read from a stream. */
+template <class T>
+inline constexpr bool is_serializable = _detail::has_serializer<T>::value;
+
+/**
+ * @brief Get the size of the record in bytes.
+ * @details Records without a serializer are counted by "sizeof".
+ * @param [in] obj - record.
+ * @return Number of bytes.
+ */
+template <class T>
+std::size_t record_size(const T& obj) noexcept {
+  if constexpr (_detail::has_serializer<T>::value)
+    return serializer<T>::size(obj);
+  else
+    return sizeof(obj);
+}
+
+/**
+ * @brief Get the size of the records in bytes.
+ * @param [in] data - records.
+ * @return Number of bytes, see "record_size".
+ */
+template <class T>
+std::size_t records_size(const std::vector<T>& data) noexcept {
+  if constexpr (_detail::has_serializer<T>::value) {
+    std::size_t res = 0;
+    for (const T& obj : data)
+      res += serializer<T>::size(obj);
+    return res;
+  }
+  else
+    return data.size() * sizeof(T);
+}
+
+/**
+ * @brief Get the bytes the records take in memory.
+ * @details Their size (see "records_size") and the unused capacity of the
+ * vector, for the memory accounting.
+ * @param [in] data - records.
+ * @return Number of bytes.
+ */
+template <class T>
+std::size_t records_memory(const std::vector<T>& data) noexcept {
+  return records_size(data) + (data.capacity() - data.size()) * sizeof(T);
+}
+
+/**
+ * @brief Get the bytes the record takes when it is read back from a stream.
+ * @details Its size and the data "serializer::read" places in the arena.
+ * @param [in] obj - record.
+ * @return Number of bytes.
+ */
+template <class T>
+std::size_t record_read_size(const T& obj) noexcept {
+  if constexpr (_detail::has_arena_size<T>::value)
+    return record_size(obj) + serializer<T>::arena_size(obj);
+  else
+    return record_size(obj);
+}
+
+} /* common:: */
+
+#endif /* COMMON_SERIALIZER_HPP_ */
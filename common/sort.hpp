@@ -0,0 +1,186 @@
+/**
+ * @file sort.hpp
+ * @brief Implementation of the sort functions of the records.
+ *
+ * @author Maxim <john.jasper.doe@gmail.com>
+ * @date 2020
+ */
+
+#ifndef COMMON_SORT_HPP_
+#define COMMON_SORT_HPP_
+
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/** @brief The namespace of the Common */
+namespace common {
+
+/** @brief Internal namespace. */
+namespace _detail {
+
+template <class T, class = void>
+struct has_string_key : std::false_type {};
+
+template <class T>
+struct has_string_key<
+    T, std::enable_if_t<std::is_convertible_v<decltype(std::declval<const T&>().key()),
+                                              std::string_view>>> : std::true_type {};
+
+/** @brief String key of the record, the order of the keys is the order of the records. */
+template <class T>
+std::string_view string_key(const T& obj) noexcept {
+  if constexpr (std::is_convertible_v<const T&, std::string_view>)
+    return obj;
+  else
+    return obj.key();
+}
+
+/** @brief String key of the sort entry. */
+inline std::string_view string_key(const std::pair<std::string_view, std::size_t>& obj) noexcept {
+  return obj.first;
+}
+
+/** @brief Byte of the key at the depth, -1 past the end. */
+inline int byte_at(std::string_view key, std::size_t depth) noexcept {
+  return depth < key.size() ? static_cast<unsigned char>(key[depth]) : -1;
+}
+
+/** @brief Insertion sort of the records equal in the first "depth" bytes. */
+template <class It>
+void insertion_sort(It first, It last, std::size_t depth) {
+  for (It it = first + 1; it < last; ++it) {
+    for (It cur = it; cur != first; --cur) {
+      std::string_view lhs = string_key(*(cur - 1)).substr(depth);
+      std::string_view rhs = string_key(*cur).substr(depth);
+      if (!(rhs < lhs))
+        break;
+      std::iter_swap(cur - 1, cur);
+    }
+  }
+}
+
+/**
+ * @brief Multikey quicksort (Bentley-Sedgewick).
+ * @details Three-way partition on one byte of the key; the records equal in
+ * that byte go one byte deeper, so shared leading bytes are looked at once
+ * per partition, not once per comparison. "poll" is called before every
+ * partition of more than "poll_size" records, so a long sort can be stopped
+ * by an exception of "poll".
+ */
+template <class It, class POLL>
+void multikey_quicksort(It first, It last, std::size_t depth, POLL& poll) {
+  const std::ptrdiff_t cutoff = 16;
+  const std::ptrdiff_t poll_size = 4096;
+
+  while (last - first > cutoff) {
+    if (last - first > poll_size)
+      poll();
+
+    /* median of three as the pivot */
+    int a = byte_at(string_key(*first), depth);
+    int b = byte_at(string_key(*(first + (last - first) / 2)), depth);
+    int c = byte_at(string_key(*(last - 1)), depth);
+    int pivot = std::max(std::min(a, b), std::min(std::max(a, b), c));
+
+    /* [first, lt) < pivot, [lt, i) == pivot, [gt, last) > pivot */
+    It lt = first;
+    It i = first;
+    It gt = last;
+    while (i < gt) {
+      int cur = byte_at(string_key(*i), depth);
+      if (cur < pivot)
+        std::iter_swap(lt++, i++);
+      else if (cur > pivot)
+        std::iter_swap(i, --gt);
+      else
+        ++i;
+    }
+
+    multikey_quicksort(first, lt, depth, poll);
+    multikey_quicksort(gt, last, depth, poll);
+
+    /* the keys of the middle part end here, it is sorted */
+    if (pivot == -1)
+      return;
+
+    first = lt;
+    last = gt;
+    ++depth;
+  }
+
+  if (last - first > 1)
+    insertion_sort(first, last, depth);
+}
+
+} /* _detail:: */
+
+/**
+ * @brief Sort the records.
+ *
+ * @details
+ * Records with a string key (strings, string views, "common::counter" of a
+ * string) are sorted by multikey quicksort, which suits prefix data well:
+ * the keys share long leading parts. Other records are sorted by
+ * "std::sort". Already sorted data (e.g. the output of a combiner) is
+ * detected in one pass and left as is.
+ *
+ * @param [in,out] data - records.
+ * @param [in] poll - called now and then by the multikey quicksort, e.g. to
+ * stop a cancelled job by an exception; the data is left unsorted then.
+ */
+template <class T, class POLL>
+void sort_records(std::vector<T>& data, POLL poll) {
+  if (std::is_sorted(data.begin(), data.end()))
+    return;
+
+  if constexpr (_detail::has_string_key<T>::value ||
+                std::is_convertible_v<const T&, std::string_view>) {
+    /* sort (key, index) pairs, the records are moved once at the end */
+    std::vector<std::pair<std::string_view, std::size_t>> keys;
+    keys.reserve(data.size());
+    for (std::size_t i = 0; i != data.size(); ++i)
+      keys.emplace_back(_detail::string_key(data[i]), i);
+
+    _detail::multikey_quicksort(keys.begin(), keys.end(), 0, poll);
+
+    std::vector<T> res;
+    res.reserve(data.size());
+    for (const auto& key : keys)
+      res.push_back(std::move(data[key.second]));
+    data.swap(res);
+  }
+  else
+    std::sort(data.begin(), data.end());
+}
+
+/**
+ * @brief Get the bytes "sort_records" allocates for the records at most.
+ * @details The keys and the sorted copy of the records, for the memory accounting.
+ * @param [in] data - records.
+ * @return Number of bytes.
+ */
+template <class T>
+std::size_t sort_memory(const std::vector<T>& data) noexcept {
+  if constexpr (_detail::has_string_key<T>::value ||
+                std::is_convertible_v<const T&, std::string_view>)
+    return data.size() * (sizeof(std::pair<std::string_view, std::size_t>) + sizeof(T));
+  else
+    return 0;
+}
+
+/**
+ * @brief Sort the records, see "sort_records" with a poll function.
+ * @param [in,out] data - records.
+ */
+template <class T>
+void sort_records(std::vector<T>& data) {
+  sort_records(data, [] {});
+}
+
+} /* common:: */
+
+#endif /* COMMON_SORT_HPP_ */
@@ -0,0 +1,286 @@
+/**
+ * @file spill.hpp
+ * @brief Definition of the classes to keep sorted runs on disk.
+ *
+ * @author Maxim <john.jasper.doe@gmail.com>
+ * @date 2020
+ */
+
+#ifndef COMMON_SPILL_HPP_
+#define COMMON_SPILL_HPP_
+
+#include <atomic>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <variant>
+#include <vector>
+
+#include "arena.hpp"
+#include "extractor.hpp"
+
+#include "run_codec.hpp"
+#include "serializer.hpp"
+
+/** @brief The namespace of the Common */
+namespace common {
+
+/**
+ * @brief Temporary directory for run files.
+ * @details The directory and all files in it are removed with the object.
+ */
+class spill_dir {
+  std::filesystem::path path_;
+  std::atomic<std::size_t> next_{0};
+
+public:
+  /**
+   * @brief Constructor with param.
+   * @param [in] base - directory to create the temporary directory in.
+   * @throw std::runtime_error - if the directory can not be created.
+   */
+  explicit spill_dir(const std::string& base) {
+    std::string tmpl = (std::filesystem::path(base) / "yamr-XXXXXX").string();
+    if (::mkdtemp(tmpl.data()) == nullptr)
+      throw std::runtime_error("Can not create spill directory in " + base);
+    path_ = tmpl;
+  }
+
+  spill_dir(const spill_dir&) = delete;
+  spill_dir& operator=(const spill_dir&) = delete;
+
+  ~spill_dir() {
+    std::error_code ec;
+    std::filesystem::remove_all(path_, ec);
+  }
+
+  /**
+   * @brief Get the path of the directory.
+   * @return Path.
+   */
+  std::string path() const {
+    return path_.string();
+  }
+
+  /**
+   * @brief Get a path for a new file.
+   * @param [in] prefix - prefix of the file name.
+   * @return Unique path inside the directory.
+   */
+  std::string make_path(const std::string& prefix) {
+    return (path_ / (prefix + "-" + std::to_string(next_++))).string();
+  }
+};
+
+/**
+ * @brief Template class "Run Writer", writes records to a run file.
+ * @details The records are encoded by "run_encoder", the encoder may buffer
+ * them until "close", which writes the end of the run.
+ */
+template <class T>
+class run_writer {
+  std::ofstream os_;
+  run_encoder<T> encoder_;
+  std::string path_;
+  std::size_t count_{0};
+
+public:
+  /**
+   * @brief Constructor with param.
+   * @param [in] path - path to the file.
+   * @throw std::runtime_error - if the file can not be created.
+   */
+  explicit run_writer(const std::string& path)
+    : os_(path, std::ios::binary | std::ios::trunc), path_(path) {
+    if (!os_)
+      throw std::runtime_error("Can not create run file " + path);
+  }
+
+  /**
+   * @brief Append a record.
+   * @param [in] obj - record.
+   */
+  void write(const T& obj) {
+    encoder_.write(os_, obj);
+    ++count_;
+  }
+
+  /**
+   * @brief Flush and close the file.
+   * @throw std::runtime_error - if the data was not written.
+   */
+  void close() {
+    encoder_.flush(os_);
+    _detail::write_run_end(os_);
+    os_.close();
+    if (!os_)
+      throw std::runtime_error("Can not write run file " + path_);
+  }
+
+  /**
+   * @brief Get number of written records.
+   * @return Number of records.
+   */
+  std::size_t count() const noexcept {
+    return count_;
+  }
+};
+
+/**
+ * @brief Template class "File Extractor".
+ *
+ * @details
+ * Has the interface of "common::extractor", but streams the records from a
+ * run file, only the current record is kept in memory. Records that view
+ * their data (e.g. "counter<std::string_view>") keep it in one of two arena
+ * generations, the older generation is released when the newer one is full.
+ * So an extracted record stays valid while at least "generation_size" more
+ * bytes are read from the same file, enough for a merge to look one record
+ * back, but not to keep the records.
+ */
+template <class T>
+class file_extractor {
+  std::ifstream is_;
+  run_decoder<T> decoder_;
+  std::optional<T> next_;
+  string_arena arenas_[2];
+  std::size_t gen_{0};
+
+public:
+  /** @brief Bytes of one arena generation. */
+  static constexpr std::size_t generation_size = 256 * 1024;
+  /**
+   * @brief Bytes an extractor holds at most, for the memory accounting: two
+   * arena generations, each may end with a chunk more, and the read buffers.
+   */
+  static constexpr std::size_t memory = 3 * generation_size;
+
+  /**
+   * @brief Constructor with param.
+   * @param [in] path - path to the run file.
+   * @throw std::runtime_error - if the file can not be opened.
+   */
+  explicit file_extractor(const std::string& path) : is_(path, std::ios::binary) {
+    if (!is_)
+      throw std::runtime_error("Can not open run file " + path);
+    read_next();
+  }
+
+  file_extractor(file_extractor&&) = default;
+  file_extractor& operator=(file_extractor&&) = default;
+
+  /**
+   * @brief Is there any next item.
+   * @return "True" - is has next item, otherwise - "False".
+   */
+  bool has_next() const noexcept {
+    return next_.has_value();
+  }
+
+  /**
+   * @brief Extract elem.
+   * @return Element.
+   */
+  T extract() {
+    T tmp = std::move(*next_);
+    read_next();
+    return tmp;
+  }
+
+  /**
+   * @brief Get element.
+   * @return Element.
+   */
+  const T& val() const noexcept {
+    return *next_;
+  }
+
+private:
+  void read_next() {
+    if (arenas_[gen_].size() >= generation_size) {
+      gen_ ^= 1;
+      arenas_[gen_].clear();
+    }
+    next_ = decoder_.read(is_, arenas_[gen_]);
+  }
+};
+
+/**
+ * @brief Template class "Run Source".
+ * @details Sorted run that is either in memory or in a run file, so both kinds
+ * can be merged by "common::merge_stream" at once.
+ */
+template <class T>
+class run_source {
+  std::variant<extractor<T>, file_extractor<T>> src_;
+
+public:
+  /**
+   * @brief Constructor with param.
+   * @param [in] data - sorted data in memory.
+   */
+  explicit run_source(std::vector<T>&& data) : src_(extractor<T>(std::move(data))) {}
+
+  /**
+   * @brief Constructor with param.
+   * @param [in] path - path to the run file.
+   */
+  explicit run_source(const std::string& path) : src_(file_extractor<T>(path)) {}
+
+  run_source(run_source&&) = default;
+  run_source& operator=(run_source&&) = default;
+
+  bool has_next() const noexcept {
+    return std::visit([](const auto& src) { return src.has_next(); }, src_);
+  }
+
+  T extract() {
+    return std::visit([](auto& src) { return src.extract(); }, src_);
+  }
+
+  const T& val() const noexcept {
+    return std::visit([](const auto& src) -> const T& { return src.val(); }, src_);
+  }
+};
+
+/**
+ * @brief Write sorted data to a run file.
+ * @param [in] data - sorted data.
+ * @param [in] path - path to the file.
+ * @return Number of written records.
+ */
+template <class T>
+std::size_t write_run(const std::vector<T>& data, const std::string& path) {
+  run_writer<T> writer(path);
+  for (const T& obj : data)
+    writer.write(obj);
+  writer.close();
+  return writer.count();
+}
+
+/**
+ * @brief Read a whole run file.
+ * @param [in] path - path to the file.
+ * @param [in] arena - arena for the data of the records, must outlive them.
+ * @return Records of the file.
+ * @throw std::runtime_error - if the file can not be opened, is truncated or is corrupted.
+ */
+template <class T>
+std::vector<T> read_run(const std::string& path, string_arena& arena) {
+  std::ifstream is(path, std::ios::binary);
+  if (!is)
+    throw std::runtime_error("Can not open run file " + path);
+
+  run_decoder<T> decoder;
+  std::vector<T> res;
+  while (std::optional<T> obj = decoder.read(is, arena))
+    res.push_back(std::move(*obj));
+  return res;
+}
+
+} /* common:: */
+
+#endif /* COMMON_SPILL_HPP_ */
@@ -9,19 +9,70 @@
 #ifndef COMMON_SPLIT_HPP_
 #define COMMON_SPLIT_HPP_
 
-#include <regex>
+#include <algorithm>
+#include <functional>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <type_traits>
 #include <vector>
 
+#include "tokenizer.hpp"
+
 /** @brief The namespace of the Common */
 namespace common {
 
+/** @brief Internal namespace. */
+namespace _detail {
+
+template <class T, class = void>
+struct has_size_member : std::false_type {};
+
+template <class T>
+struct has_size_member<T, std::void_t<decltype(std::declval<const T&>().size())>>
+  : std::true_type {};
+
+template <class T, class = void>
+struct has_strlen_member : std::false_type {};
+
+template <class T>
+struct has_strlen_member<T, std::void_t<decltype(std::declval<const T&>().strlen())>>
+  : std::true_type {};
+
+/**
+ * @brief Check the character is a record separator.
+ * @note Matches the set of characters skipped by "std::istream >>".
+ */
+constexpr bool is_space(char c) noexcept {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+}
+
+} /* _detail:: */
+
+/**
+ * @brief Estimated cost of a record.
+ * @details The size of the record ("size" or "strlen" of the key) plus one, so
+ * that empty records still count; one for the records without a size.
+ * @param [in] obj - record.
+ * @return Weight of the record.
+ */
+template <class T>
+std::size_t record_weight(const T& obj) noexcept {
+  if constexpr (_detail::has_size_member<T>::value)
+    return static_cast<std::size_t>(obj.size()) + 1;
+  else if constexpr (_detail::has_strlen_member<T>::value)
+    return static_cast<std::size_t>(obj.strlen()) + 1;
+  else
+    return 1;
+}
+
 /**
  * @brief The function slices a string into substrings.
  *
  * @details
  * This function slices a given string into substrings and writes them to a
- * string vector. The line feed character ("<space>") is used as a separator.
+ * string vector. Runs of whitespace are used as separators, they are found
+ * by the vectorized "for_each_token".
  *
  * @note If the delimiter is at the beginning of the line, then the first
  * substring will be empty. That is, the line is empty before the separator.
@@ -30,17 +81,20 @@ namespace common {
  * @return Vector of substrings.
  */
 inline std::vector<std::string> split(const std::string& str) {
-  std::regex ws_re("\\s+");
-  return std::vector<std::string>{std::sregex_token_iterator(str.begin(), str.end(), ws_re, -1),
-                                  std::sregex_token_iterator()};
+  std::vector<std::string> res;
+  if (str.empty() || _detail::is_space(str.front()))
+    res.emplace_back();
+  for_each_token(str, [&res](std::string_view token) { res.emplace_back(token); });
+  return res;
 }
 
 /**
  * @brief Cutting the original data into a specified number of parts.
  *
  * @details
- * The function slices the input data vector into the specified number of data
- * vectors.
+ * The function slices the input data vector into at most the specified number
+ * of contiguous data vectors of about the same weight (see "record_weight"),
+ * so a part of long strings gets fewer records than a part of short ones.
  *
  * @param [in] input - input data vector.
  * @param [in] parts - a given number of parts.
@@ -50,21 +104,145 @@ template <class T>
 std::vector<std::vector<T>> split(std::vector<T>&& input, std::size_t parts) {
   std::vector<std::vector<T>> res;
 
-  std::size_t size = input.size();
-  std::size_t idx = 0;
-  for (std::size_t i = 0; i < size; ++i) {
+  std::size_t total = 0;
+  for (const T& obj : input)
+    total += record_weight(obj);
+
+  std::size_t acc = 0;
+  for (T& obj : input) {
+    /* the part the weight before the record falls into */
+    std::size_t idx = std::min(parts - 1, acc * parts / total);
     if (res.size() < idx + 1)
-      res.push_back(std::vector<T>{});
+      res.emplace_back();
 
-    res[idx].push_back(std::move(input[i]));
-    idx = (idx + 1) % parts;
+    acc += record_weight(obj);
+    res.back().push_back(std::move(obj));
   }
 
   return res;
 }
 
+/**
+ * @brief Routing the data into a specified number of buckets by hash.
+ *
+ * @details
+ * Equal elements always land in the same bucket, so every bucket can be
+ * reduced on its own. The bucket vector has exactly "parts" entries, some of
+ * them may be empty.
+ *
+ * @param [in] input - input data vector.
+ * @param [in] parts - a given number of buckets.
+ * @return Vector of buckets.
+ */
+template <class T, class Hash = std::hash<T>>
+std::vector<std::vector<T>> split_hash(std::vector<T>&& input, std::size_t parts) {
+  std::vector<std::vector<T>> res(parts);
+
+  Hash hash;
+  for (T& elem : input) {
+    std::size_t idx = hash(elem) % parts;
+    res[idx].push_back(std::move(elem));
+  }
+
+  return res;
+}
+
+/** @brief Internal namespace. */
+namespace _detail {
+
+/**
+ * @brief Find the end of a chunk.
+ * @details The end is moved forward from "begin + size" to the nearest separator.
+ */
+inline std::size_t chunk_end(std::string_view buf, std::size_t begin, std::size_t size) noexcept {
+  std::size_t end = std::min(buf.size(), begin + size);
+  while (end < buf.size() && !is_space(buf[end]))
+    ++end;
+  return end;
+}
+
+/** @brief Collect the whitespace separated records of the range. */
+inline std::vector<std::string_view> records(std::string_view buf, std::size_t begin,
+                                             std::size_t end) {
+  return tokenize(buf.substr(begin, end - begin));
+}
+
+} /* _detail:: */
+
+/**
+ * @brief Cutting a raw buffer into a specified number of record chunks.
+ *
+ * @details
+ * The buffer is cut into byte ranges of about the same size. Every range
+ * boundary is moved forward to the nearest separator, so no record is torn
+ * between two chunks. The records of each chunk are whitespace separated and
+ * are returned as views into the source buffer, nothing is copied.
+ *
+ * @param [in] buf - input buffer, must outlive the result.
+ * @param [in] parts - a given number of parts.
+ * @return Vector of chunks, each chunk is a vector of records.
+ */
+inline std::vector<std::vector<std::string_view>> split_records(std::string_view buf,
+                                                                std::size_t parts) {
+  std::vector<std::vector<std::string_view>> res;
+  if (parts == 0)
+    parts = 1;
+
+  std::size_t chunk = buf.size() / parts + 1;
+  std::size_t begin = 0;
+  while (begin < buf.size()) {
+    std::size_t end = _detail::chunk_end(buf, begin, chunk);
+    std::vector<std::string_view> records = _detail::records(buf, begin, end);
+    if (!records.empty())
+      res.push_back(std::move(records));
+    begin = end;
+  }
+
+  return res;
+}
+
+/**
+ * @brief Class "Record Reader".
+ *
+ * @details
+ * Reads a raw buffer chunk by chunk, the same way "split_records" cuts it,
+ * but one chunk per call. Lets a job start mapping before the whole input is
+ * scanned.
+ */
+class record_reader {
+  std::string_view buf_;
+  std::size_t chunk_;
+  std::size_t pos_{0};
+
+public:
+  /**
+   * @brief Constructor with param.
+   * @param [in] buf - input buffer, must outlive the records.
+   * @param [in] chunk - size of a chunk in bytes.
+   */
+  record_reader(std::string_view buf, std::size_t chunk) noexcept
+    : buf_(buf), chunk_(std::max<std::size_t>(chunk, 1)) {}
+
+  /**
+   * @brief Read the next chunk.
+   * @return Records of the chunk, empty if the buffer is over.
+   */
+  std::optional<std::vector<std::string_view>> next() {
+    while (pos_ < buf_.size()) {
+      std::size_t end = _detail::chunk_end(buf_, pos_, chunk_);
+      std::vector<std::string_view> records = _detail::records(buf_, pos_, end);
+      pos_ = end;
+      if (!records.empty())
+        return records;
+    }
+    return std::nullopt;
+  }
+};
+
 /**
  * @brief Split long vector to reduce threads.
+ * @details The clusters hold about the same weight (see "record_weight") and
+ * are closed only between two different elements.
  * @param [in] vec - is a long vector of sorted elements.
  * @param [in] parts -  a given number of parts.
  * @return Vector of vectors, contain all unique elements.
@@ -73,36 +251,25 @@ template <class T>
 std::vector<std::vector<T>> split_reduce(std::vector<T>&& vec, std::size_t parts) {
   std::vector<std::vector<T>> res;
 
-  std::size_t num_cluster = (vec.size() / parts) + (vec.size() % parts ? 1 : 0);
+  std::size_t total = 0;
+  for (const T& obj : vec)
+    total += record_weight(obj);
+  std::size_t num_cluster = (total / parts) + (total % parts ? 1 : 0);
 
+  std::size_t inserted = num_cluster;
   auto it = vec.begin();
-  auto it_prev = it;
-
-  while (it_prev != vec.end()) {
-    res.emplace_back();
-    std::vector<T>& cluster = res.back();
-
-    /* fill this cluster */
-    std::size_t inserted_count{0};
-    while (inserted_count < num_cluster) {
-      if (it == vec.end() || *it != *it_prev) {
-        std::copy(std::make_move_iterator(it_prev), std::make_move_iterator(it),
-                  std::back_inserter(cluster));
-        std::size_t moved_count = std::distance(it_prev, it);
-        inserted_count += moved_count;
-
-        it_prev = it;
-        if (it_prev == vec.end())
-          break;
-
-        ++it;
-      }
-      else
-        ++it;
+  while (it != vec.end()) {
+    /* the group of equal elements goes to one cluster */
+    auto last = std::find_if(it, vec.end(), [&it](const T& obj) { return obj != *it; });
+    if (inserted >= num_cluster) {
+      res.emplace_back();
+      inserted = 0;
     }
 
-    if (it_prev == vec.end())
-      break;
+    for (; it != last; ++it) {
+      inserted += record_weight(*it);
+      res.back().push_back(std::move(*it));
+    }
   }
 
   return res;
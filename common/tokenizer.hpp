@@ -0,0 +1,182 @@
+/**
+ * @file tokenizer.hpp
+ * @brief Implementation of the vectorized whitespace tokenizer.
+ *
+ * @author Maxim <john.jasper.doe@gmail.com>
+ * @date 2020
+ */
+
+#ifndef COMMON_TOKENIZER_HPP_
+#define COMMON_TOKENIZER_HPP_
+
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define COMMON_TOKENIZER_X86_ 1
+#include <immintrin.h>
+#endif
+
+/** @brief The namespace of the Common */
+namespace common {
+
+/** @brief Instruction set of the tokenizer. */
+enum class simd_level { scalar, sse2, avx2 };
+
+/** @brief Internal namespace. */
+namespace _detail {
+
+/** @brief Bytes scanned at once, one bit of the mask per byte. */
+constexpr std::size_t token_block = 64;
+
+/** @brief Mask of the whitespace bytes of a block. */
+using space_mask_fn = std::uint64_t (*)(const char*) noexcept;
+
+/** @brief Whitespace is ' ' and '\t', '\n', '\v', '\f', '\r' (0x09 - 0x0D), as "std::isspace". */
+inline std::uint64_t space_mask_scalar(const char* p) noexcept {
+  std::uint64_t res = 0;
+  for (std::size_t i = 0; i != token_block; ++i) {
+    auto c = static_cast<unsigned char>(p[i]);
+    res |= static_cast<std::uint64_t>(c == ' ' || static_cast<unsigned char>(c - '\t') < 5) << i;
+  }
+  return res;
+}
+
+#ifdef COMMON_TOKENIZER_X86_
+
+__attribute__((target("sse2"))) inline std::uint64_t space_mask_sse2(const char* p) noexcept {
+  const __m128i space = _mm_set1_epi8(' ');
+  const __m128i tab = _mm_set1_epi8('\t');
+  const __m128i four = _mm_set1_epi8(4);
+
+  std::uint64_t res = 0;
+  for (std::size_t i = 0; i != token_block; i += 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+    /* c - '\t' <= 4 as unsigned bytes */
+    __m128i ctl = _mm_sub_epi8(v, tab);
+    __m128i is_ctl = _mm_cmpeq_epi8(_mm_min_epu8(ctl, four), ctl);
+    __m128i is_space = _mm_or_si128(_mm_cmpeq_epi8(v, space), is_ctl);
+    res |= static_cast<std::uint64_t>(static_cast<std::uint16_t>(_mm_movemask_epi8(is_space)))
+           << i;
+  }
+  return res;
+}
+
+__attribute__((target("avx2"))) inline std::uint64_t space_mask_avx2(const char* p) noexcept {
+  const __m256i space = _mm256_set1_epi8(' ');
+  const __m256i tab = _mm256_set1_epi8('\t');
+  const __m256i four = _mm256_set1_epi8(4);
+
+  std::uint64_t res = 0;
+  for (std::size_t i = 0; i != token_block; i += 32) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+    __m256i ctl = _mm256_sub_epi8(v, tab);
+    __m256i is_ctl = _mm256_cmpeq_epi8(_mm256_min_epu8(ctl, four), ctl);
+    __m256i is_space = _mm256_or_si256(_mm256_cmpeq_epi8(v, space), is_ctl);
+    res |= static_cast<std::uint64_t>(static_cast<std::uint32_t>(_mm256_movemask_epi8(is_space)))
+           << i;
+  }
+  return res;
+}
+
+#endif /* COMMON_TOKENIZER_X86_ */
+
+/** @brief Mask function of the instruction set, the scalar one if it is not supported. */
+inline space_mask_fn space_mask(simd_level level) noexcept {
+#ifdef COMMON_TOKENIZER_X86_
+  if (level == simd_level::avx2 && __builtin_cpu_supports("avx2"))
+    return space_mask_avx2;
+  if (level != simd_level::scalar && __builtin_cpu_supports("sse2"))
+    return space_mask_sse2;
+#endif
+  static_cast<void>(level);
+  return space_mask_scalar;
+}
+
+} /* _detail:: */
+
+/**
+ * @brief Get the best instruction set of the tokenizer on this CPU.
+ * @return Instruction set.
+ */
+inline simd_level best_simd_level() noexcept {
+#ifdef COMMON_TOKENIZER_X86_
+  static const simd_level level = __builtin_cpu_supports("avx2")   ? simd_level::avx2
+                                  : __builtin_cpu_supports("sse2") ? simd_level::sse2
+                                                                   : simd_level::scalar;
+  return level;
+#else
+  return simd_level::scalar;
+#endif
+}
+
+/**
+ * @brief Call the function for every whitespace separated token of the buffer.
+ *
+ * @details
+ * The buffer is scanned by blocks of 64 bytes: a vectorized compare gives the
+ * mask of the whitespace bytes of the block, the starts and the ends of the
+ * tokens are the bit transitions of the mask. So the cost is a few
+ * instructions per block plus one per token, not a branch per byte. The tail
+ * of the buffer is copied into a block padded with spaces.
+ *
+ * @param [in] buf - buffer, the tokens are views into it.
+ * @param [in] func - function called with every token in order.
+ * @param [in] level - instruction set, the best one of the CPU by default.
+ */
+template <class F>
+void for_each_token(std::string_view buf, F&& func, simd_level level = best_simd_level()) {
+  const _detail::space_mask_fn mask = _detail::space_mask(level);
+  const std::size_t block = _detail::token_block;
+
+  /* is the byte before the block whitespace, the start of the open token */
+  std::uint64_t prev_space = 1;
+  std::size_t start = 0;
+
+  auto scan = [&](std::uint64_t space, std::size_t base) {
+    std::uint64_t word = ~space;
+    std::uint64_t starts = word & ((space << 1) | prev_space);
+    std::uint64_t ends = space & ((word << 1) | (prev_space ^ 1));
+    prev_space = space >> 63;
+
+    for (std::uint64_t edges = starts | ends; edges != 0; edges &= edges - 1) {
+      std::size_t pos = base + static_cast<std::size_t>(__builtin_ctzll(edges));
+      if (starts & (edges & -edges))
+        start = pos;
+      else
+        func(buf.substr(start, pos - start));
+    }
+  };
+
+  std::size_t base = 0;
+  for (; base + block <= buf.size(); base += block)
+    scan(mask(buf.data() + base), base);
+
+  if (base != buf.size()) {
+    char tail[block];
+    std::memset(tail, ' ', block);
+    std::memcpy(tail, buf.data() + base, buf.size() - base);
+    scan(mask(tail), base);
+  }
+  else if (prev_space == 0)
+    func(buf.substr(start));
+}
+
+/**
+ * @brief Get the whitespace separated tokens of the buffer.
+ * @param [in] buf - buffer, must outlive the result.
+ * @param [in] level - instruction set, the best one of the CPU by default.
+ * @return Tokens, views into the buffer.
+ */
+inline std::vector<std::string_view> tokenize(std::string_view buf,
+                                              simd_level level = best_simd_level()) {
+  std::vector<std::string_view> res;
+  for_each_token(buf, [&res](std::string_view token) { res.push_back(token); }, level);
+  return res;
+}
+
+} /* common:: */
+
+#endif /* COMMON_TOKENIZER_HPP_ */
@@ -0,0 +1,74 @@
+/**
+ * @file approx_job.hpp
+ * @brief Map and reduce functions of the approximate prefix job.
+ *
+ * @author Maxim <john.jasper.doe@gmail.com>
+ * @date 2020
+ */
+
+#ifndef CORE_APPROX_JOB_HPP_
+#define CORE_APPROX_JOB_HPP_
+
+#include <cstddef>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "job_control.hpp"
+
+#include "../common/prefix_sketch.hpp"
+
+/** @brief The namespace of the MAP REDUCE project */
+namespace yamr {
+/** @brief The namespace of the Core */
+namespace core {
+
+/**
+ * @brief The mapper of the approximate job.
+ *
+ * @details
+ * Unlike "mapper_func" no prefix is emitted. The prefixes of the lines of
+ * the split are counted in one "common::prefix_sketch", so the output of a
+ * map task has a fixed size whatever the size of the split is.
+ */
+struct approx_map {
+  /** @brief Longest prefix tracked. */
+  std::size_t max_len;
+  /** @brief Counters per prefix length. */
+  std::size_t capacity;
+
+  template <class DATA_TYPE>
+  std::vector<common::prefix_sketch> operator()(std::vector<DATA_TYPE>&& lines) const {
+    common::prefix_sketch sketch(max_len, capacity);
+    for (const DATA_TYPE& s : lines) {
+      check_stop();
+      sketch.insert(std::string_view(s));
+    }
+
+    std::vector<common::prefix_sketch> res;
+    res.push_back(std::move(sketch));
+    return res;
+  }
+};
+
+/**
+ * @brief The reducer of the approximate job.
+ * @details Merges the sketches into the first one, is used as the final
+ * function as well. The estimate is got by "prefix_sketch::estimate".
+ * @param [in] sketches - sketches.
+ * @return Merged sketch, a sketch of no prefix if there are no sketches.
+ */
+inline common::prefix_sketch approx_reducer_func(std::vector<common::prefix_sketch>&& sketches) {
+  if (sketches.empty())
+    return common::prefix_sketch(std::vector<common::space_saving>(), 0);
+
+  common::prefix_sketch res = std::move(sketches.front());
+  for (std::size_t i = 1; i != sketches.size(); ++i)
+    res.merge(sketches[i]);
+  return res;
+}
+
+} /* core:: */
+} /* yamr:: */
+
+#endif /* CORE_APPROX_JOB_HPP_ */
@@ -0,0 +1,92 @@
+/**
+ * @file bounded_queue.hpp
+ * @brief Definition of the class "Bounded Queue".
+ *
+ * @author Maxim <john.jasper.doe@gmail.com>
+ * @date 2020
+ */
+
+#ifndef CORE_BOUNDED_QUEUE_HPP_
+#define CORE_BOUNDED_QUEUE_HPP_
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <optional>
+
+/** @brief The namespace of the MAP REDUCE project */
+namespace yamr {
+/** @brief The namespace of the Core */
+namespace core {
+
+/**
+ * @brief Template class "Bounded Queue".
+ * @details Multi-producer multi-consumer queue, "push" blocks while the queue
+ * is full, so a fast producer can not run ahead of the consumers.
+ */
+template <class T>
+class bounded_queue {
+  std::deque<T> items_;
+  std::size_t capacity_;
+  bool closed_{false};
+
+  std::mutex mtx_;
+  std::condition_variable not_full_;
+  std::condition_variable not_empty_;
+
+public:
+  /**
+   * @brief Constructor with param.
+   * @param [in] capacity - max number of items in the queue.
+   */
+  explicit bounded_queue(std::size_t capacity) noexcept : capacity_{capacity ? capacity : 1} {}
+
+  /**
+   * @brief Put an item, waits while the queue is full.
+   * @param [in] item - item.
+   * @return "True" - the item is queued, "False" - the queue is closed, e.g.
+   * by a failed consumer, the item is dropped.
+   */
+  bool push(T&& item) {
+    std::unique_lock<std::mutex> lock(mtx_);
+    not_full_.wait(lock, [this] { return items_.size() < capacity_ || closed_; });
+    if (closed_)
+      return false;
+    items_.push_back(std::move(item));
+    lock.unlock();
+    not_empty_.notify_one();
+    return true;
+  }
+
+  /**
+   * @brief Take an item, waits while the queue is empty and not closed.
+   * @return Item, empty if the queue is closed and drained.
+   */
+  std::optional<T> pop() {
+    std::unique_lock<std::mutex> lock(mtx_);
+    not_empty_.wait(lock, [this] { return !items_.empty() || closed_; });
+    if (items_.empty())
+      return std::nullopt;
+
+    T item = std::move(items_.front());
+    items_.pop_front();
+    lock.unlock();
+    not_full_.notify_one();
+    return item;
+  }
+
+  /** @brief No more items will be pushed, wakes up all producers and consumers. */
+  void close() {
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      closed_ = true;
+    }
+    not_empty_.notify_all();
+    not_full_.notify_all();
+  }
+};
+
+} /* core:: */
+} /* yamr:: */
+
+#endif /* CORE_BOUNDED_QUEUE_HPP_ */
@@ -0,0 +1,94 @@
+/**
+ * @file combiner.hpp
+ * @brief Definition of the combiner function.
+ *
+ * @author Maxim <john.jasper.doe@gmail.com>
+ * @date 2020
+ */
+
+#ifndef CORE_COMBINER_HPP_
+#define CORE_COMBINER_HPP_
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <type_traits>
+#include <vector>
+
+#include "../common/sort.hpp"
+
+/** @brief The namespace of the MAP REDUCE project */
+namespace yamr {
+/** @brief The namespace of the Core */
+namespace core {
+
+/**
+ * @brief Alias of the pointer on function for the combine stage.
+ * @details The combiner runs inside every map task on the output of the map
+ * function, before the shuffle.
+ */
+template <class DATA_TYPE>
+using cfunc_ptr_t = std::function<std::vector<DATA_TYPE>(std::vector<DATA_TYPE>&&)>;
+
+/** @brief The namespace to hide the implementation. */
+namespace _details {
+
+/**
+ * @brief Is the combine function set.
+ * @details "nullptr", empty "std::function" and null pointers are not set.
+ */
+template <class CFUNC>
+bool has_combiner(const CFUNC& cfunc) noexcept {
+  if constexpr (std::is_same_v<CFUNC, std::nullptr_t>)
+    return false;
+  else if constexpr (std::is_constructible_v<bool, const CFUNC&>)
+    return static_cast<bool>(cfunc);
+  else
+    return true;
+}
+
+/** @brief Run the combine function if it is set, otherwise return the data as is. */
+template <class CFUNC, class DATA_TYPE>
+std::vector<DATA_TYPE> combine(const CFUNC& cfunc, std::vector<DATA_TYPE>&& data) {
+  if constexpr (!std::is_same_v<CFUNC, std::nullptr_t>) {
+    if (has_combiner(cfunc))
+      return cfunc(std::move(data));
+  }
+  return std::move(data);
+}
+
+} /* _details:: */
+
+/**
+ * @brief The combiner of function.
+ *
+ * @details
+ * Sorts the map output and folds every run of equal elements into its first
+ * element with "add_count", so only one element per key leaves the map task.
+ * The output stays sorted.
+ *
+ * @tparam DATA_TYPE - Data type used, must provide "count" and "add_count".
+ */
+template <class DATA_TYPE>
+std::vector<DATA_TYPE> combiner_func(std::vector<DATA_TYPE>&& data) {
+  common::sort_records(data);
+
+  auto dst = data.begin();
+  for (auto it = data.begin(); it != data.end(); ++it) {
+    if (dst != data.begin() && *std::prev(dst) == *it)
+      std::prev(dst)->add_count(it->count());
+    else {
+      if (dst != it)
+        *dst = std::move(*it);
+      ++dst;
+    }
+  }
+  data.erase(dst, data.end());
+
+  return std::move(data);
+}
+
+} /* core:: */
+} /* yamr:: */
+
+#endif /* CORE_COMBINER_HPP_ */
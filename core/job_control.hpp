@@ -0,0 +1,183 @@
+/**
+ * @file job_control.hpp
+ * @brief Definition of the classes to control asynchronous jobs.
+ *
+ * @author Maxim <john.jasper.doe@gmail.com>
+ * @date 2020
+ */
+
+#ifndef CORE_JOB_CONTROL_HPP_
+#define CORE_JOB_CONTROL_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+/** @brief The namespace of the MAP REDUCE project */
+namespace yamr {
+/** @brief The namespace of the Core */
+namespace core {
+
+/** @brief Exception of a job that was cancelled or ran out of time. */
+class job_cancelled : public std::runtime_error {
+public:
+  using std::runtime_error::runtime_error;
+};
+
+/**
+ * @brief Class "Job Control".
+ * @details Shared by a job and its handle. The tasks of the job call "check"
+ * between the batches of their work, and the map and reduce loops call
+ * "check_stop" every few records, so cancellation is cooperative: a user
+ * function that does not loop through "map_each" or call "check_stop" is
+ * finished first.
+ */
+class job_control {
+  using clock_t = std::chrono::steady_clock;
+
+  std::atomic<bool> cancelled_{false};
+  /** @brief Deadline of the job, "max" - none. */
+  clock_t::time_point deadline_{clock_t::time_point::max()};
+
+public:
+  /**
+   * @brief Constructor with param.
+   * @param [in] timeout - time limit of the job, zero - no limit.
+   */
+  explicit job_control(std::chrono::milliseconds timeout = std::chrono::milliseconds::zero()) {
+    if (timeout != std::chrono::milliseconds::zero())
+      deadline_ = clock_t::now() + timeout;
+  }
+
+  /** @brief Ask the job to stop. */
+  void cancel() noexcept {
+    cancelled_ = true;
+  }
+
+  /**
+   * @brief Is the job asked to stop or out of time.
+   * @return "True" - the job must stop, otherwise - "False".
+   */
+  bool stopped() const noexcept {
+    return cancelled_ || clock_t::now() >= deadline_;
+  }
+
+  /**
+   * @brief Stop the calling task if the job must stop.
+   * @throw job_cancelled - if the job is cancelled or out of time.
+   */
+  void check() const {
+    if (cancelled_)
+      throw job_cancelled("Job is cancelled");
+    if (clock_t::now() >= deadline_)
+      throw job_cancelled("Job is out of time");
+  }
+};
+
+/** @brief The namespace to hide the implementation. */
+namespace _details {
+
+/** @brief Control of the job whose task runs on the thread, "nullptr" - none. */
+inline const job_control*& task_control() noexcept {
+  thread_local const job_control* res = nullptr;
+  return res;
+}
+
+} /* _details:: */
+
+/**
+ * @brief Class "Control Scope".
+ * @details Makes the control of a job current on the thread while a task of
+ * the job runs; the previous one is restored, e.g. after a task run by a
+ * waiting worker of another job.
+ */
+class control_scope {
+  const job_control* prev_;
+
+public:
+  explicit control_scope(const job_control* control) noexcept
+    : prev_(_details::task_control()) {
+    _details::task_control() = control;
+  }
+
+  control_scope(const control_scope&) = delete;
+  control_scope& operator=(const control_scope&) = delete;
+
+  ~control_scope() {
+    _details::task_control() = prev_;
+  }
+};
+
+/**
+ * @brief Stop the calling task if its job must stop.
+ * @details For the per-record loops of the map and reduce functions: the
+ * control of the job is looked at every 1024 calls on the thread, so a call
+ * costs an increment. Does nothing outside of the tasks of a job.
+ * @throw job_cancelled - if the job is cancelled or out of time.
+ */
+inline void check_stop() {
+  const job_control* control = _details::task_control();
+  if (control == nullptr)
+    return;
+
+  thread_local std::uint32_t calls = 0;
+  if ((++calls & 1023) == 0)
+    control->check();
+}
+
+/**
+ * @brief Template class "Job Handle".
+ * @details Result of an asynchronous job. The errors of the job, including
+ * "job_cancelled", are rethrown by "get".
+ */
+template <class T>
+class job_handle {
+  std::future<T> result_;
+  std::shared_ptr<job_control> control_;
+
+public:
+  job_handle(std::future<T>&& result, std::shared_ptr<job_control> control) noexcept
+    : result_(std::move(result)), control_(std::move(control)) {}
+
+  job_handle(job_handle&&) = default;
+  job_handle& operator=(job_handle&&) = default;
+
+  /** @brief Ask the job to stop, "get" throws "job_cancelled" unless it has finished. */
+  void cancel() noexcept {
+    control_->cancel();
+  }
+
+  /**
+   * @brief Wait for the job at most the given time.
+   * @param [in] timeout - time to wait.
+   * @return Status of the result.
+   */
+  template <class Rep, class Period>
+  std::future_status wait_for(const std::chrono::duration<Rep, Period>& timeout) const {
+    return result_.wait_for(timeout);
+  }
+
+  /** @brief Wait for the job. */
+  void wait() const {
+    result_.wait();
+  }
+
+  /**
+   * @brief Wait for the job and get its result, may be called once.
+   * @return Result of the job.
+   * @throw job_cancelled - if the job was cancelled or ran out of time.
+   * @throw std::exception - the error of a function of the job.
+   */
+  T get() {
+    return result_.get();
+  }
+};
+
+} /* core:: */
+} /* yamr:: */
+
+#endif /* CORE_JOB_CONTROL_HPP_ */
@@ -9,12 +9,18 @@
 #ifndef CORE_MAPPER_HPP_
 #define CORE_MAPPER_HPP_
 
+#include <exception>
 #include <functional>
 #include <future>
 #include <string>
-#include <thread>
+#include <string_view>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+#include "job_control.hpp"
+#include "thread_pool.hpp"
+
 /** @brief The namespace of the MAP REDUCE project */
 namespace yamr {
 /** @brief The namespace of the Core */
@@ -24,64 +30,114 @@ namespace core {
 template <class DATA_TYPE, class OUT_TYPE>
 using mfunc_ptr_t = std::function<std::vector<OUT_TYPE>(std::vector<DATA_TYPE>&&)>;
 
-/** @brief The mapper class */
-template <class DATA_TYPE, class OUT_TYPE>
+/**
+ * @brief The mapper class
+ * @tparam FUNC - type of the map function, any callable that takes the part of
+ * the input; a lambda or a functor is called directly, without type erasure.
+ */
+template <class DATA_TYPE, class OUT_TYPE, class FUNC = mfunc_ptr_t<DATA_TYPE, OUT_TYPE>>
 class mapper {
-  using thread_ptr_t = std::unique_ptr<std::thread, std::function<void(std::thread*)>>;
-
   /** @brief Map function. */
-  mfunc_ptr_t<DATA_TYPE, OUT_TYPE> function_;
+  FUNC function_;
 
 public:
-  explicit mapper(mfunc_ptr_t<DATA_TYPE, OUT_TYPE> map_func) noexcept : function_{map_func} {}
+  explicit mapper(FUNC map_func) noexcept : function_{std::move(map_func)} {}
 
   /**
    * @brief Function to execute.
-   * @param [in] input - input data.
+   * @param [in] input - input data, one task per part.
+   * @param [in] pool - pool to run the tasks on, task "i" prefers the NUMA node "i % nodes".
    * @return Processed data.
+   * @throw The first error of the tasks, after all of them are finished.
    */
-  std::vector<std::vector<OUT_TYPE>> exec(std::vector<std::vector<DATA_TYPE>>&& input) noexcept {
+  std::vector<std::vector<OUT_TYPE>> exec(std::vector<std::vector<DATA_TYPE>>&& input,
+                                           thread_pool& pool) {
     std::vector<std::vector<OUT_TYPE>> res;
 
-    std::vector<std::promise<std::vector<OUT_TYPE>>> promises(input.size());
     std::vector<std::future<std::vector<OUT_TYPE>>> futures;
-    for (size_t i = 0; i != promises.size(); ++i) {
-      futures.push_back(promises[i].get_future());
-    }
-
-    /* worker function */
-    auto worker = [this](std::promise<std::vector<OUT_TYPE>>&& promise,
-                         std::vector<DATA_TYPE>&& arg) {
-      std::vector<OUT_TYPE> res = function_(std::move(arg));
-      promise.set_value(std::move(res));
-    };
-
-    std::vector<thread_ptr_t> workers;
-    for (size_t i = 0; i != promises.size(); ++i) {
-      workers.emplace_back(
-          thread_ptr_t(new std::thread(worker, std::move(promises[i]), std::move(input[i])),
-                       [](std::thread* t) { t->join(); }));
+    for (size_t i = 0; i != input.size(); ++i) {
+      futures.push_back(pool.submit(
+          [this, arg = std::move(input[i])]() mutable { return function_(std::move(arg)); },
+          i));
     }
 
+    /* every task is waited for before an error is rethrown, they use the object;
+       a worker that runs a nested stage helps with the tasks meanwhile */
+    std::exception_ptr error;
     for (size_t i = 0; i != futures.size(); ++i) {
-      res.push_back(futures[i].get());
+      pool.wait(futures[i]);
+      try {
+        res.push_back(futures[i].get());
+      }
+      catch (...) {
+        if (!error)
+          error = std::current_exception();
+      }
     }
+    if (error)
+      std::rethrow_exception(error);
 
     return res;
   }
 };
 
+/**
+ * @brief Adapter of a per-record map function.
+ *
+ * @details
+ * The function is called as "func(record, emit)" for every record of the map
+ * task and passes the output records to "emit", which constructs them in the
+ * output of the task. The loop, the function and "emit" are all known at
+ * compile time, so the whole per-record path can be inlined. The loop calls
+ * "check_stop", a cancelled job stops in the middle of the part.
+ *
+ * @tparam OUT_TYPE - Output data type.
+ * @param [in] func - per-record map function.
+ * @return Map function of a whole part of the input.
+ */
+template <class OUT_TYPE, class FUNC>
+auto map_each(FUNC func) {
+  return [func](auto&& lines) {
+    std::vector<OUT_TYPE> res;
+    auto emit = [&res](auto&&... args) { res.emplace_back(std::forward<decltype(args)>(args)...); };
+    for (const auto& rec : lines) {
+      check_stop();
+      func(rec, emit);
+    }
+    return res;
+  };
+}
+
+/**
+ * @brief Per-record map function of the job, emits every prefix of the record.
+ * @details
+ * With "std::string_view" input and keys, the prefixes view the input
+ * itself, nothing is allocated per prefix.
+ *
+ * @tparam OUT_TYPE - Output data type, is constructed from a prefix.
+ */
 template <class OUT_TYPE>
-std::vector<OUT_TYPE> mapper_func(std::vector<std::string>&& lines) {
-  std::vector<OUT_TYPE> res;
+struct prefix_map {
+  template <class DATA_TYPE, class EMIT>
+  void operator()(const DATA_TYPE& s, EMIT& emit) const {
+    using key_t = typename OUT_TYPE::value_type;
+    static_assert(!std::is_same_v<key_t, std::string_view> || std::is_same_v<DATA_TYPE, key_t>,
+                  "View keys need view input, the lines are released with the map task");
 
-  for (const std::string& s : lines) {
     for (size_t len = 1; len != s.size() + 1; ++len) {
-      res.emplace_back(s.substr(0, len));
+      emit(key_t(s.substr(0, len)));
     }
   }
+};
 
-  return res;
+/**
+ * @brief The mapper of function.
+ * @tparam OUT_TYPE - Output data type, is constructed from a prefix.
+ * @tparam DATA_TYPE - Input data type, "std::string" or "std::string_view".
+ */
+template <class OUT_TYPE, class DATA_TYPE = std::string>
+std::vector<OUT_TYPE> mapper_func(std::vector<DATA_TYPE>&& lines) {
+  return map_each<OUT_TYPE>(prefix_map<OUT_TYPE>{})(std::move(lines));
 }
 
 } /* core:: */
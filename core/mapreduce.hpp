@@ -9,12 +9,38 @@
 #ifndef CORE_MAPREDUCE_HPP_
 #define CORE_MAPREDUCE_HPP_
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
 #include <string>
+#include <typeinfo>
 
+#include "bounded_queue.hpp"
+#include "combiner.hpp"
+#include "job_control.hpp"
 #include "mapper.hpp"
+#include "process_pool.hpp"
 #include "reducer.hpp"
+#include "stats.hpp"
+#include "thread_pool.hpp"
 
+#include "../common/arena.hpp"
+#include "../common/checkpoint.hpp"
+#include "../common/memory_budget.hpp"
 #include "../common/merge.hpp"
+#include "../common/serializer.hpp"
+#include "../common/sort.hpp"
+#include "../common/spill.hpp"
 #include "../common/split.hpp"
 
 /** @brief The namespace of the MAP REDUCE project */
@@ -26,42 +52,1363 @@ namespace core {
 template <class DATA_TYPE, class OUT_TYPE>
 using out_func_ptr_t = std::function<OUT_TYPE(std::vector<DATA_TYPE>&&)>;
 
+/** @brief Alias of the input source of the streaming mode, empty when the input is over. */
+template <class DATA_TYPE>
+using source_func_ptr_t = std::function<std::optional<std::vector<DATA_TYPE>>()>;
+
+/** @brief How map output is delivered to the reducers. */
+enum class shuffle_mode {
+  /** @brief Sort every map output, merge them and split the merged data by ranges. */
+  sort_merge,
+  /** @brief Route map output into "rnum" sorted buckets by hash, a reducer merges its bucket. */
+  hash
+};
+
+/** @brief The namespace to hide the implementation. */
+namespace _details {
+
+/**
+ * @brief Sizes the batches of records of a map task by the output they produce.
+ *
+ * @details
+ * The output of a record is not known before it is mapped, so the first
+ * batch is small and the second one is twice as big. An output that grows
+ * with the batch sizes the next batches by the largest output per record so
+ * far. An output that hardly grows (e.g. a summary of a fixed size) is not
+ * cut at all: more batches would only multiply it.
+ */
+class batch_sizer {
+  /** @brief Bytes of output of a batch. */
+  std::size_t target_;
+  std::size_t next_{1024};
+  /** @brief Bytes of output of the first batch. */
+  std::size_t first_bytes_{0};
+  /** @brief Bytes of output of the last batch. */
+  std::size_t last_bytes_{0};
+  std::size_t per_record_{0};
+  std::size_t batches_{0};
+
+public:
+  /**
+   * @brief Constructor with param.
+   * @param [in] target - bytes of output of a batch.
+   */
+  explicit batch_sizer(std::size_t target) noexcept : target_(target) {}
+
+  /**
+   * @brief Get the number of records of the next batch.
+   * @return Number of records.
+   */
+  std::size_t next() const noexcept {
+    return next_;
+  }
+
+  /**
+   * @brief Get the expected output of a batch.
+   * @param [in] num - records of the batch.
+   * @return Bytes of output, zero before the first batch.
+   */
+  std::size_t estimate(std::size_t num) const noexcept {
+    if (next_ == std::numeric_limits<std::size_t>::max())
+      return last_bytes_;
+    return per_record_ * num;
+  }
+
+  /**
+   * @brief Add the output of a batch.
+   * @param [in] num - records of the batch.
+   * @param [in] bytes - bytes of its output.
+   */
+  void add(std::size_t num, std::size_t bytes) noexcept {
+    per_record_ = std::max(per_record_, bytes / num + 1);
+    last_bytes_ = bytes;
+    if (++batches_ == 1) {
+      first_bytes_ = bytes;
+      next_ = 2 * num;
+      return;
+    }
+
+    /* twice the records, less than a quarter more output */
+    if (batches_ == 2 && 4 * bytes < 5 * first_bytes_)
+      next_ = std::numeric_limits<std::size_t>::max();
+    else if (next_ != std::numeric_limits<std::size_t>::max())
+      next_ = std::max<std::size_t>(target_ / per_record_, 1);
+  }
+};
+
+} /* _details:: */
+
 /** @brief The map_reduce class */
 template <class DATA_TYPE, class MAPPER_OUT_TYPE, class REDUCER_OUT_TYPE, class OUT_TYPE>
 class map_reduce {
   std::size_t mnum_;
   std::size_t rnum_;
 
+  /** @brief Pool owned by the object, if an external one was not given. */
+  std::unique_ptr<thread_pool> own_pool_;
+  /** @brief Placement of the workers of the own pool. */
+  thread_pool::placement where_{thread_pool::placement::none};
+  /** @brief Pool to run map and reduce tasks on, empty while the own pool is stopped. */
+  thread_pool* pool_;
+
+  shuffle_mode shuffle_{shuffle_mode::sort_merge};
+
+  /** @brief Bytes of map output kept in memory before spilling, zero - no limit. */
+  std::size_t spill_budget_{0};
+  /** @brief Directory for run files. */
+  std::string spill_path_;
+
+  /** @brief Work directory of the map checkpoints, empty - no checkpoints. */
+  std::string checkpoint_path_;
+  /** @brief Checkpoint of the current job. */
+  std::unique_ptr<common::map_checkpoint> checkpoint_;
+
+  /** @brief Number of worker processes of "run_processes". */
+  std::size_t procs_{1};
+  /** @brief Directory for the files exchanged by the worker processes. */
+  std::string work_path_{"/tmp"};
+
+  /**
+   * @brief Arenas of the last job.
+   * @details Keep the data of the records read back from disk, the result of
+   * the job may view it. Released in bulk when the next job starts.
+   */
+  std::deque<common::string_arena> arenas_;
+  std::mutex arenas_mtx_;
+
+  /** @brief Statistics of the stages of the jobs. */
+  job_stats stats_;
+
+  /** @brief Bytes of the records held by the current job. */
+  common::memory_budget budget_;
+
+  /** @brief Group of the tasks of the object in the pool. */
+  std::size_t group_{thread_pool::make_group()};
+  /** @brief Control of the current job, empty if the job can not be stopped. */
+  std::shared_ptr<job_control> control_;
+
 public:
-  explicit map_reduce(std::size_t mnum, std::size_t rnum) noexcept : mnum_{mnum}, rnum_{rnum} {}
+  /**
+   * @brief Constructor with param, the object owns a pool of "max(mnum, rnum)" workers.
+   * @param [in] mnum - number of map tasks.
+   * @param [in] rnum - number of reduce tasks.
+   */
+  explicit map_reduce(std::size_t mnum, std::size_t rnum)
+    : map_reduce(mnum, rnum, thread_pool::placement::none) {}
+
+  /**
+   * @brief Constructor with param, the object owns a pool of "max(mnum, rnum)" workers
+   * placed on the NUMA nodes.
+   *
+   * @details
+   * Map task "i" and the merge and reduce tasks of key range "i" prefer the
+   * node "i % nodes", a map task copies its input part on its node before
+   * mapping. So the input part, the map output and a key range are allocated
+   * on the node that processes them, and a reduce task finds its range on its
+   * own node when the merge task of the range ran there.
+   *
+   * @param [in] mnum - number of map tasks.
+   * @param [in] rnum - number of reduce tasks.
+   * @param [in] where - placement of the workers.
+   */
+  map_reduce(std::size_t mnum, std::size_t rnum, thread_pool::placement where)
+    : mnum_{mnum},
+      rnum_{rnum},
+      own_pool_{std::make_unique<thread_pool>(std::max(mnum, rnum), where)},
+      where_{where},
+      pool_{own_pool_.get()} {}
+
+  /**
+   * @brief Constructor with param, tasks run on a shared pool.
+   * @param [in] mnum - number of map tasks.
+   * @param [in] rnum - number of reduce tasks.
+   * @param [in] pool - pool to run tasks on, must outlive the object.
+   */
+  explicit map_reduce(std::size_t mnum, std::size_t rnum, thread_pool& pool) noexcept
+    : mnum_{mnum}, rnum_{rnum}, pool_{&pool} {}
+
+  /**
+   * @brief Set the shuffle mode.
+   * @param [in] mode - shuffle mode.
+   */
+  void set_shuffle(shuffle_mode mode) noexcept {
+    shuffle_ = mode;
+  }
+
+  /**
+   * @brief Set the memory-bounded mode of the sort-merge shuffle.
+   *
+   * @details
+   * A map task maps its input part in batches, so that every worker buffers
+   * about "budget / workers" bytes of output, and sorts every batch. Once the
+   * sorted map output held in memory exceeds the budget, every next batch is
+   * written to a run file. The runs are merged as a stream, the merged data
+   * is cut into the reducer key ranges (at most the share of a worker each)
+   * on disk and every reduce task reads only its own range.
+   *
+   * @param [in] budget - bytes of map output kept in memory, zero - no limit.
+   * @param [in] path - directory for run files.
+   */
+  void set_spill(std::size_t budget, const std::string& path) {
+    spill_budget_ = budget;
+    spill_path_ = path;
+  }
+
+  /**
+   * @brief Set the worker processes of "run_processes".
+   * @param [in] procs - number of worker processes.
+   * @param [in] path - directory for the intermediate files, e.g. "/dev/shm"
+   * to keep them in shared memory.
+   */
+  void set_processes(std::size_t procs, const std::string& path) {
+    procs_ = std::max<std::size_t>(procs, 1);
+    work_path_ = path;
+  }
+
+  /**
+   * @brief Set the checkpoints of the map output.
+   *
+   * @details
+   * The sorted output of every map task of "run" is saved to the work
+   * directory as soon as the task is done (see "common::map_checkpoint"). A
+   * job run again after a failure, e.g. of the reduce stage, reads back the
+   * output of the input parts it has already mapped and maps only the rest.
+   * The directory is cleaned up when the job is done. The spilling sort-merge
+   * shuffle (a spill budget or a memory limit) does not use checkpoints.
+   *
+   * @param [in] path - work directory of the job, empty - no checkpoints.
+   */
+  void set_checkpoint(const std::string& path) {
+    checkpoint_path_ = path;
+  }
+
+  /**
+   * @brief Set the memory limit of the jobs.
+   *
+   * @details
+   * The records held by the job are charged to a budget by the memory they
+   * take (see "common::records_memory"), with the scratch of the sort, the
+   * arenas and the buffers of the run files. The sort-merge shuffle keeps the
+   * map output in memory up to half of the limit and spills the rest as in
+   * "set_spill", the merged data is cut into key ranges small enough for all
+   * workers to reduce at once. Its map batches, merges and reduce tasks wait
+   * for their bytes while the budget is exhausted. Other charges over the
+   * limit (e.g. a merge of the hash shuffle) stop the job with
+   * "common::memory_limit_error". The peak usage of every stage is reported in
+   * the statistics. The input is not charged, and the limit is not applied to
+   * "run_stream" and "run_processes".
+   *
+   * @param [in] limit - bytes of records, zero - no limit.
+   */
+  void set_memory_limit(std::size_t limit) noexcept {
+    budget_.set_limit(limit);
+  }
+
+  /**
+   * @brief Get the statistics of the stages.
+   * @details The statistics accumulate over the jobs of the object until they
+   * are cleared. Stages run outside of the object (e.g. reading the input) may
+   * be added by the caller.
+   * @return Statistics.
+   */
+  job_stats& stats() noexcept {
+    return stats_;
+  }
+
+  /**
+   * @brief Run the job.
+   *
+   * @details
+   * The functions are template parameters, so lambdas and functors (e.g. the
+   * per-record "map_each" adapter) are called directly and can be inlined into
+   * the tasks. "std::function" objects, e.g. of the "mfunc_ptr_t" family, are
+   * accepted as well and cost one indirect call per task.
+   *
+   * @param [in] input - input data, is split into "mnum" parts.
+   * @param [in] mfunc - map function.
+   * @param [in] rfunc - reduce function.
+   * @param [in] ofunc - final data processing function.
+   * @return Result of the final function.
+   * @throw common::memory_limit_error - if the memory limit is exceeded.
+   */
+  template <class MFUNC, class RFUNC, class OFUNC>
+  OUT_TYPE run(std::vector<DATA_TYPE>&& input, MFUNC mfunc, RFUNC rfunc, OFUNC ofunc) {
+    return run(std::move(input), std::move(mfunc), nullptr, std::move(rfunc), std::move(ofunc));
+  }
+
+  /**
+   * @brief Run the job with a combine stage.
+   * @param [in] input - input data, is split into "mnum" parts.
+   * @param [in] mfunc - map function.
+   * @param [in] cfunc - combine function, is run in every map task, may be empty or "nullptr".
+   * @param [in] rfunc - reduce function.
+   * @param [in] ofunc - final data processing function.
+   * @return Result of the final function.
+   * @throw common::memory_limit_error - if the memory limit is exceeded.
+   */
+  template <class MFUNC, class CFUNC, class RFUNC, class OFUNC>
+  OUT_TYPE run(std::vector<DATA_TYPE>&& input, MFUNC mfunc, CFUNC cfunc, RFUNC rfunc,
+               OFUNC ofunc) {
+    std::vector<std::vector<DATA_TYPE>> splitted;
+    {
+      stage_timer timer(stats_, stats_.stage("split"));
+      std::size_t size = input.size();
+      splitted = common::split(std::move(input), mnum_);
+      stats_.add_records(stats_.stage("split"), size, size);
+    }
+    return run(std::move(splitted), std::move(mfunc), std::move(cfunc), std::move(rfunc),
+               std::move(ofunc));
+  }
+
+  /**
+   * @brief Run the job on already split input.
+   * @details Every part of the input is processed by its own map task, so the
+   * caller decides how the input is chunked (e.g. by "common::split_records").
+   * @param [in] splitted - input data parts.
+   * @param [in] mfunc - map function.
+   * @param [in] rfunc - reduce function.
+   * @param [in] ofunc - final data processing function.
+   * @return Result of the final function.
+   * @throw common::memory_limit_error - if the memory limit is exceeded.
+   */
+  template <class MFUNC, class RFUNC, class OFUNC>
+  OUT_TYPE run(std::vector<std::vector<DATA_TYPE>>&& splitted, MFUNC mfunc, RFUNC rfunc,
+               OFUNC ofunc) {
+    return run(std::move(splitted), std::move(mfunc), nullptr, std::move(rfunc), std::move(ofunc));
+  }
+
+  /**
+   * @brief Run the job with a combine stage on already split input.
+   * @param [in] splitted - input data parts.
+   * @param [in] mfunc - map function.
+   * @param [in] cfunc - combine function, is run in every map task, may be empty or "nullptr".
+   * @param [in] rfunc - reduce function.
+   * @param [in] ofunc - final data processing function.
+   * @return Result of the final function.
+   * @throw common::memory_limit_error - if the memory limit is exceeded.
+   */
+  template <class MFUNC, class CFUNC, class RFUNC, class OFUNC>
+  OUT_TYPE run(std::vector<std::vector<DATA_TYPE>>&& splitted, MFUNC mfunc, CFUNC cfunc,
+               RFUNC rfunc, OFUNC ofunc) {
+    control_.reset();
+    return run_job(std::move(splitted), std::move(mfunc), std::move(cfunc), std::move(rfunc),
+                   std::move(ofunc));
+  }
+
+  /**
+   * @brief Start the job on already split input.
+   *
+   * @details
+   * The job is driven by its own thread, its tasks run on the pool of the
+   * object. Objects that share a pool get their tasks scheduled fairly, so
+   * several jobs can run at once. The tasks check the handle between their
+   * batches (a map, combine, merge or reduce call, an input chunk), and the
+   * map and reduce loops, the sort and the merge of the spilled runs check it
+   * every few records (see "check_stop"), so a cancelled or timed out job
+   * stops soon; a user function that loops by itself should call
+   * "check_stop" as well. Errors of the functions are rethrown by the handle.
+   *
+   * @note One job at a time per object; the object must outlive the handle,
+   * the destructor of the handle waits for the job.
+   *
+   * @param [in] splitted - input data parts.
+   * @param [in] mfunc - map function.
+   * @param [in] cfunc - combine function, is run in every map task, may be empty or "nullptr".
+   * @param [in] rfunc - reduce function.
+   * @param [in] ofunc - final data processing function.
+   * @param [in] timeout - time limit of the job, zero - no limit.
+   * @return Handle of the job.
+   */
+  template <class MFUNC, class CFUNC, class RFUNC, class OFUNC>
+  job_handle<OUT_TYPE> run_async(
+      std::vector<std::vector<DATA_TYPE>>&& splitted, MFUNC mfunc, CFUNC cfunc, RFUNC rfunc,
+      OFUNC ofunc, std::chrono::milliseconds timeout = std::chrono::milliseconds::zero()) {
+    control_ = std::make_shared<job_control>(timeout);
+    std::future<OUT_TYPE> res =
+        std::async(std::launch::async, [this, splitted = std::move(splitted),
+                                        mfunc = std::move(mfunc), cfunc = std::move(cfunc),
+                                        rfunc = std::move(rfunc),
+                                        ofunc = std::move(ofunc)]() mutable {
+          return run_job(std::move(splitted), std::move(mfunc), std::move(cfunc),
+                         std::move(rfunc), std::move(ofunc));
+        });
+    return job_handle<OUT_TYPE>(std::move(res), control_);
+  }
+
+  /**
+   * @brief Run the job as a pipeline over a stream of input chunks.
+   *
+   * @details
+   * The calling thread reads chunks from the source and puts them into a
+   * bounded queue, "mnum" map tasks take the chunks as soon as they are read.
+   * Every map task routes its output into "rnum" buckets by hash, sorts them and
+   * hands the sorted runs over to the buckets at once; a bucket that collects
+   * too many runs is merged by the task that fills it, while other chunks are
+   * still being read and mapped. When the input is over, every reduce task
+   * merges the runs of its bucket and reduces them.
+   *
+   * The first error of the source or of the functions stops the job: the
+   * reading and the other map tasks stop at the next chunk, the error is
+   * rethrown once the running tasks are done.
+   *
+   * @note Must not be called from a task of the pool the job runs on.
+   *
+   * @param [in] source - input chunks.
+   * @param [in] mfunc - map function.
+   * @param [in] cfunc - combine function, is run in every map task, may be empty or "nullptr".
+   * @param [in] rfunc - reduce function.
+   * @param [in] ofunc - final data processing function.
+   * @return Result of the final function.
+   */
+  template <class SOURCE, class MFUNC, class CFUNC, class RFUNC, class OFUNC>
+  OUT_TYPE run_stream(SOURCE source, MFUNC mfunc, CFUNC cfunc, RFUNC rfunc, OFUNC ofunc) {
+    using run_t = std::vector<MAPPER_OUT_TYPE>;
+
+    /* runs a bucket collects before they are merged into one */
+    const std::size_t fanin = 8;
+
+    struct bucket {
+      std::mutex mtx;
+      std::vector<run_t> runs;
+    };
+
+    thread_pool::group_scope scope(group_);
+    start_pool();
+    control_.reset();
+    arenas_.clear();
+
+    auto mtask = map_task(std::move(mfunc), std::move(cfunc));
+    auto rtask = reduce_task(std::move(rfunc));
+
+    bounded_queue<std::vector<DATA_TYPE>> chunks(2 * mnum_);
+    std::vector<bucket> buckets(rnum_);
+
+    auto add_run = [this, fanin](bucket& dst, run_t&& run) {
+      std::vector<run_t> full;
+      {
+        std::lock_guard<std::mutex> lock(dst.mtx);
+        dst.runs.push_back(std::move(run));
+        if (dst.runs.size() < fanin)
+          return;
+        full.swap(dst.runs);
+      }
+
+      run_t merged = merge_task(std::move(full));
+      std::lock_guard<std::mutex> lock(dst.mtx);
+      dst.runs.push_back(std::move(merged));
+    };
+
+    /* the first error stops the job: the queue is closed, so the reader and the other map
+       tasks stop at the next chunk */
+    std::exception_ptr error;
+    std::mutex error_mtx;
+    std::atomic<bool> failed{false};
+    auto fail = [&](std::exception_ptr err) {
+      {
+        std::lock_guard<std::mutex> lock(error_mtx);
+        if (!error)
+          error = err;
+      }
+      failed = true;
+      chunks.close();
+    };
+
+    /* Run MAP and SHUFFLE as soon as chunks arrive */
+    std::optional<stage_timer> map_timer(std::in_place, stats_, stats_.stage("map"));
+    std::vector<std::future<void>> mappers;
+    for (std::size_t i = 0; i != mnum_; ++i) {
+      mappers.push_back(pool_->submit([&]() {
+        try {
+          while (std::optional<std::vector<DATA_TYPE>> chunk = chunks.pop()) {
+            if (failed)
+              break;
+            std::vector<run_t> parts = partition(mtask(std::move(*chunk)));
+            for (std::size_t p = 0; p != parts.size(); ++p) {
+              if (parts[p].empty())
+                continue;
+              sort_run(parts[p]);
+              add_run(buckets[p], std::move(parts[p]));
+            }
+          }
+        }
+        catch (...) {
+          fail(std::current_exception());
+        }
+      }));
+    }
+
+    /* READ on the calling thread */
+    try {
+      while (std::optional<std::vector<DATA_TYPE>> chunk = task("read", source)) {
+        stats_.add_records(stats_.stage("read"), chunk->size(), chunk->size());
+        if (!chunks.push(std::move(*chunk)))
+          break;
+      }
+    }
+    catch (...) {
+      fail(std::current_exception());
+    }
+    chunks.close();
+
+    for (std::future<void>& fut : mappers)
+      fut.get();
+    map_timer.reset();
+    if (error)
+      std::rethrow_exception(error);
+
+    /* Run REDUCE, every task merges the runs of its bucket */
+    std::vector<REDUCER_OUT_TYPE> rres;
+    {
+      stage_timer timer(stats_, stats_.stage("reduce"));
+      std::vector<std::future<REDUCER_OUT_TYPE>> reducers;
+      for (bucket& src : buckets) {
+        if (src.runs.empty())
+          continue;
+        reducers.push_back(pool_->submit([this, &rtask, &src]() {
+          return rtask(merge_task(std::move(src.runs)));
+        }));
+      }
+
+      /* the tasks view the buckets, all of them are done before an error is rethrown */
+      for (std::future<REDUCER_OUT_TYPE>& fut : reducers)
+        fut.wait();
+      for (std::future<REDUCER_OUT_TYPE>& fut : reducers)
+        rres.push_back(fut.get());
+    }
+
+    /* Final data processing */
+    return output(ofunc, std::move(rres));
+  }
+
+  /**
+   * @brief Run the job on new input against the state of the previous runs.
+   *
+   * @details
+   * The state is the merged (and combined) output of the map tasks of all
+   * previous runs, kept in a run file. Only the new input is mapped; its
+   * sorted output is merged with the state as one more sorted run, the merged
+   * data is reduced and written back as the new state. So the result is the
+   * result of the job on all inputs so far, while the old input is neither
+   * kept nor mapped again. With a combiner the state holds one record per key.
+   *
+   * The new state replaces the old one only when the final function is done,
+   * so a failed run leaves the old state and may simply be run again.
+   *
+   * @param [in] splitted - new input data parts.
+   * @param [in] mfunc - map function.
+   * @param [in] cfunc - combine function, is run in every map task, may be empty or "nullptr".
+   * @param [in] rfunc - reduce function.
+   * @param [in] ofunc - final data processing function.
+   * @param [in] state - path to the state file, the first run creates it.
+   * @return Result of the final function.
+   * @throw std::runtime_error - if the state can not be read or written.
+   */
+  template <class MFUNC, class CFUNC, class RFUNC, class OFUNC>
+  OUT_TYPE run_incremental(std::vector<std::vector<DATA_TYPE>>&& splitted, MFUNC mfunc,
+                           CFUNC cfunc, RFUNC rfunc, OFUNC ofunc, const std::string& state) {
+    if (std::filesystem::exists(state) && !std::filesystem::is_regular_file(state))
+      throw std::runtime_error("State " + state + " is not a regular file");
+
+    thread_pool::group_scope scope(group_);
+    start_pool();
+    control_.reset();
+    arenas_.clear();
+    budget_.clear();
+
+    auto mtask = map_task(std::move(mfunc), cfunc);
+    auto rtask = reduce_task(std::move(rfunc));
+
+    /* Run MAP on the new input only */
+    auto map_sort = [this, &mtask](std::vector<DATA_TYPE>&& arg) {
+      std::vector<MAPPER_OUT_TYPE> res = mtask(std::move(arg));
+      budget_.charge(common::records_memory(res), "map output");
+      sort_run(res);
+      return res;
+    };
+    core::mapper<DATA_TYPE, MAPPER_OUT_TYPE, decltype(map_sort)> mapper(map_sort);
+    std::vector<std::vector<MAPPER_OUT_TYPE>> mres = exec_stage("map", mapper, splitted);
+
+    /* The state is one more sorted run */
+    if (std::filesystem::exists(state)) {
+      stage_timer timer(stats_, stats_.stage("state_read"));
+      mres.push_back(common::read_run<MAPPER_OUT_TYPE>(state, task_arena()));
+      budget_.charge(common::records_memory(mres.back()), "state");
+      stats_.add_records(stats_.stage("state_read"), mres.back().size(), mres.back().size(),
+                         std::filesystem::file_size(state));
+    }
+
+    std::vector<std::vector<MAPPER_OUT_TYPE>> rsplitted = merge_runs(std::move(mres), cfunc);
+
+    /* The new state is written aside, the reduce tasks take the merged data */
+    const std::string tmp = state + ".tmp";
+    try {
+      {
+        stage_timer timer(stats_, stats_.stage("state_write"));
+        common::run_writer<MAPPER_OUT_TYPE> writer(tmp);
+        for (const std::vector<MAPPER_OUT_TYPE>& range : rsplitted) {
+          for (const MAPPER_OUT_TYPE& obj : range)
+            writer.write(obj);
+        }
+        writer.close();
+        stats_.add_records(stats_.stage("state_write"), writer.count(), writer.count(),
+                           std::filesystem::file_size(tmp));
+      }
+
+      /* Run REDUCE */
+      std::vector<REDUCER_OUT_TYPE> rres;
+      {
+        core::reducer<MAPPER_OUT_TYPE, REDUCER_OUT_TYPE, decltype(rtask)> reducer(rtask);
+        rres = exec_stage("reduce", reducer, rsplitted);
+      }
+
+      /* Final data processing, the state is replaced at once only when the job is done */
+      OUT_TYPE res = output(ofunc, std::move(rres));
+      std::filesystem::rename(tmp, state);
+      return res;
+    }
+    catch (...) {
+      /* a failed run leaves the old state */
+      std::error_code ec;
+      std::filesystem::remove(tmp, ec);
+      throw;
+    }
+  }
+
+  /**
+   * @brief Run the job on worker processes.
+   *
+   * @details
+   * The map and reduce tasks run on the worker processes of a
+   * "core::process_pool", the coordinator only hands out the tasks:
+   * - "map <i>": the worker maps the part "i" of the input, routes the output
+   *   into "rnum" buckets by hash, sorts them and writes every bucket to its
+   *   own file "map-<i>-<p>";
+   * - "reduce <p>": the worker merges the files "map-*-<p>", reduces them and
+   *   writes the result to the file "reduce-<p>".
+   * The files are written under a temporary name and renamed when complete,
+   * so a task of a crashed worker is simply run again on another one. The
+   * input reaches the workers by the fork, the messages carry task numbers.
+   *
+   * @note The functions run in the worker processes, they must not touch the
+   * threads of the calling process; the result of the job is read back from
+   * the files of the reducers. The workers are forked while the process has
+   * no other threads (see "core::process_pool"): the own pool is stopped for
+   * the job and started again by the next job that needs it, a shared pool
+   * can not be stopped and is refused.
+   *
+   * @param [in] splitted - input data parts.
+   * @param [in] mfunc - map function.
+   * @param [in] cfunc - combine function, is run in every map task, may be empty or "nullptr".
+   * @param [in] rfunc - reduce function.
+   * @param [in] ofunc - final data processing function.
+   * @return Result of the final function.
+   * @throw std::runtime_error - if a task failed on all attempts.
+   * @throw std::system_error - if the workers can not be started.
+   * @throw std::logic_error - if the tasks run on a shared pool.
+   */
+  template <class MFUNC, class CFUNC, class RFUNC, class OFUNC>
+  OUT_TYPE run_processes(std::vector<std::vector<DATA_TYPE>>&& splitted, MFUNC mfunc,
+                         CFUNC cfunc, RFUNC rfunc, OFUNC ofunc) {
+    /* attempts of a task before the job fails */
+    const std::size_t attempts = 3;
+
+    if (!own_pool_ && pool_)
+      throw std::logic_error("Worker processes can not be forked beside a shared pool");
+    own_pool_.reset();
+    pool_ = nullptr;
 
-  OUT_TYPE run(std::vector<DATA_TYPE>&& input, mfunc_ptr_t<DATA_TYPE, MAPPER_OUT_TYPE> mfunc,
-               rfunc_ptr_t<MAPPER_OUT_TYPE, REDUCER_OUT_TYPE> rfunc,
-               out_func_ptr_t<REDUCER_OUT_TYPE, OUT_TYPE> ofunc) noexcept {
-    std::vector<std::vector<DATA_TYPE>> splitted = common::split(std::move(input), mnum_);
+    control_.reset();
+    arenas_.clear();
+    common::spill_dir dir(work_path_);
+    auto file = [&dir](const std::string& name) { return dir.path() + "/" + name; };
+    auto publish = [](auto&& data, const std::string& path) {
+      common::write_run(data, path + ".tmp");
+      std::filesystem::rename(path + ".tmp", path);
+    };
+    const std::size_t mnum = splitted.size();
+
+    /* the handler runs in the workers, it must not touch the stats or the pool */
+    auto handler = [&](const std::string& line) -> std::string {
+      std::istringstream cmd(line);
+      std::string op;
+      std::size_t idx = 0;
+      if (!(cmd >> op >> idx))
+        throw std::runtime_error("bad command");
+
+      if (op == "map" && idx < mnum) {
+        std::vector<MAPPER_OUT_TYPE> out = mfunc(std::vector<DATA_TYPE>(splitted[idx]));
+        std::size_t size = out.size();
+        if (_details::has_combiner(cfunc))
+          out = _details::combine(cfunc, std::move(out));
+
+        std::vector<std::vector<MAPPER_OUT_TYPE>> buckets =
+            common::split_hash(std::move(out), rnum_);
+        for (std::size_t p = 0; p != buckets.size(); ++p) {
+          common::sort_records(buckets[p]);
+          publish(buckets[p], file("map-" + std::to_string(idx) + "-" + std::to_string(p)));
+        }
+        return std::to_string(splitted[idx].size()) + " " + std::to_string(size);
+      }
+
+      if (op == "reduce" && idx < rnum_) {
+        common::string_arena arena;
+        std::vector<std::vector<MAPPER_OUT_TYPE>> runs;
+        std::size_t size = 0;
+        for (std::size_t i = 0; i != mnum; ++i) {
+          runs.push_back(common::read_run<MAPPER_OUT_TYPE>(
+              file("map-" + std::to_string(i) + "-" + std::to_string(idx)), arena));
+          size += runs.back().size();
+        }
+        if (size == 0)
+          return "0";
+
+        std::vector<REDUCER_OUT_TYPE> res;
+        res.push_back(rfunc(common::merge_tournament<MAPPER_OUT_TYPE>(std::move(runs))));
+        publish(res, file("reduce-" + std::to_string(idx)));
+        return std::to_string(size);
+      }
+
+      throw std::runtime_error("unknown command " + line);
+    };
+    process_pool workers(procs_, handler);
 
     /* Run MAP */
-    core::mapper<DATA_TYPE, MAPPER_OUT_TYPE> mapper(mfunc);
-    std::vector<std::vector<MAPPER_OUT_TYPE>> mres = mapper.exec(std::move(splitted));
+    {
+      stage_timer timer(stats_, stats_.stage("map"));
+      std::vector<std::string> cmds;
+      for (std::size_t i = 0; i != mnum; ++i)
+        cmds.push_back("map " + std::to_string(i));
 
-    /* Sorted */
-    std::for_each(mres.begin(), mres.end(),
-                  [](std::vector<MAPPER_OUT_TYPE>& vec) { std::sort(vec.begin(), vec.end()); });
+      for (const std::string& answer : workers.run(cmds, attempts)) {
+        std::istringstream is(answer);
+        std::size_t in = 0;
+        std::size_t out = 0;
+        is >> in >> out;
+        stats_.add_records(stats_.stage("map"), in, out);
+      }
+    }
 
-    /* MERGE */
-    std::vector<MAPPER_OUT_TYPE> smerged = common::merge<MAPPER_OUT_TYPE>(std::move(mres));
+    /* Run REDUCE, the coordinator reads back the results */
+    std::vector<REDUCER_OUT_TYPE> rres;
+    {
+      stage_timer timer(stats_, stats_.stage("reduce"));
+      std::vector<std::string> cmds;
+      for (std::size_t p = 0; p != rnum_; ++p)
+        cmds.push_back("reduce " + std::to_string(p));
 
-    /* Split for reducing */
-    std::vector<std::vector<MAPPER_OUT_TYPE>> rsplitted =
-        common::split_reduce<MAPPER_OUT_TYPE>(std::move(smerged), rnum_);
+      std::vector<std::string> answers = workers.run(cmds, attempts);
+      for (std::size_t p = 0; p != answers.size(); ++p) {
+        if (answers[p] == "0")
+          continue;
+        std::vector<REDUCER_OUT_TYPE> res =
+            common::read_run<REDUCER_OUT_TYPE>(file("reduce-" + std::to_string(p)), task_arena());
+        stats_.add_records(stats_.stage("reduce"), std::stoul(answers[p]), res.size());
+        std::move(res.begin(), res.end(), std::back_inserter(rres));
+      }
+    }
 
-    /* Run REDUCE */
-    core::reducer<MAPPER_OUT_TYPE, REDUCER_OUT_TYPE> reducer(rfunc);
-    std::vector<REDUCER_OUT_TYPE> rres = reducer.exec(std::move(rsplitted));
+    /* Final data processing */
+    return output(ofunc, std::move(rres));
+  }
+
+private:
+  /** @brief Run the job in the pool group of the object, errors are thrown. */
+  template <class MFUNC, class CFUNC, class RFUNC, class OFUNC>
+  OUT_TYPE run_job(std::vector<std::vector<DATA_TYPE>>&& splitted, MFUNC mfunc, CFUNC cfunc,
+                   RFUNC rfunc, OFUNC ofunc) {
+    thread_pool::group_scope scope(group_);
+    start_pool();
+    control_scope control(control_.get());
+    arenas_.clear();
+    budget_.clear();
+
+    auto mtask = map_task(std::move(mfunc), cfunc);
+    auto rtask = reduce_task(std::move(rfunc));
+
+    /* the map output depends on the record types, the combiner and the buckets of the shuffle */
+    checkpoint_.reset();
+    if (!checkpoint_path_.empty()) {
+      std::ostringstream job;
+      job << typeid(DATA_TYPE).name() << " " << typeid(MAPPER_OUT_TYPE).name() << " "
+          << _details::has_combiner(cfunc) << " "
+          << (shuffle_ == shuffle_mode::hash ? "hash " + std::to_string(rnum_) : "sort");
+      checkpoint_ = std::make_unique<common::map_checkpoint>(checkpoint_path_, job.str());
+    }
+
+    std::vector<REDUCER_OUT_TYPE> rres =
+        shuffle_ == shuffle_mode::hash ? run_hash(std::move(splitted), mtask, rtask)
+                                       : run_sort_merge(std::move(splitted), mtask, cfunc, rtask);
+    if (checkpoint_) {
+      checkpoint_->remove();
+      checkpoint_.reset();
+    }
 
     /* Final data processing */
+    return output(ofunc, std::move(rres));
+  }
+
+  template <class MFUNC, class CFUNC, class RFUNC>
+  std::vector<REDUCER_OUT_TYPE> run_sort_merge(std::vector<std::vector<DATA_TYPE>>&& splitted,
+                                               MFUNC& mfunc, const CFUNC& cfunc,
+                                               RFUNC& rfunc) {
+    if (spill_budget_ != 0 || budget_.limit() != 0)
+      return run_spill(std::move(splitted), mfunc, rfunc);
+
+    /* Run MAP, every task sorts its own output */
+    auto map_sort = [this, &mfunc](std::vector<DATA_TYPE>&& arg) {
+      std::vector<std::vector<MAPPER_OUT_TYPE>> res =
+          checkpointed(std::move(arg), [this, &mfunc](std::vector<DATA_TYPE>&& part) {
+            std::vector<std::vector<MAPPER_OUT_TYPE>> out(1);
+            out.front() = mfunc(std::move(part));
+            sort_run(out.front());
+            return out;
+          });
+      budget_.charge(common::records_memory(res.front()), "map output");
+      return std::move(res.front());
+    };
+    core::mapper<DATA_TYPE, MAPPER_OUT_TYPE, decltype(map_sort)> mapper(map_sort);
+    std::vector<std::vector<MAPPER_OUT_TYPE>> mres = exec_stage("map", mapper, splitted);
+
+    std::vector<std::vector<MAPPER_OUT_TYPE>> rsplitted = merge_runs(std::move(mres), cfunc);
+
+    /* Run REDUCE */
+    core::reducer<MAPPER_OUT_TYPE, REDUCER_OUT_TYPE, RFUNC> reducer(rfunc);
+    return exec_stage("reduce", reducer, rsplitted);
+  }
+
+  /**
+   * @brief Merge the sorted runs into the key ranges of the reducers.
+   * @param [in] runs - sorted runs.
+   * @param [in] cfunc - combine function, is run on every merged range.
+   * @return Merged key ranges, in the order of the keys.
+   */
+  template <class CFUNC>
+  std::vector<std::vector<MAPPER_OUT_TYPE>> merge_runs(
+      std::vector<std::vector<MAPPER_OUT_TYPE>>&& runs, const CFUNC& cfunc) {
+    /* Split the runs into the key ranges of the reducers, with a combiner an
+       oversized key may be spread over several ranges */
+    std::vector<std::vector<std::vector<MAPPER_OUT_TYPE>>> ranges;
+    {
+      stage_timer timer(stats_, stats_.stage("split_reduce"));
+      std::size_t size = 0;
+      for (const std::vector<MAPPER_OUT_TYPE>& run : runs)
+        size += run.size();
+      ranges = common::split_runs<MAPPER_OUT_TYPE>(std::move(runs), rnum_,
+                                                   _details::has_combiner(cfunc));
+      stats_.add_records(stats_.stage("split_reduce"), size, size);
+    }
+
+    /* MERGE every key range in its own task, the merged range is charged before it is
+       allocated and the runs are released once they are merged */
+    auto merge = [this, &cfunc](std::vector<std::vector<MAPPER_OUT_TYPE>>&& arg) {
+      std::size_t bytes = 0;
+      for (const std::vector<MAPPER_OUT_TYPE>& run : arg)
+        bytes += common::records_memory(run);
+      budget_.charge(bytes, "merge of a key range");
+
+      std::vector<MAPPER_OUT_TYPE> res = merge_task(std::move(arg));
+      budget_.release(bytes);
+      if (_details::has_combiner(cfunc)) {
+        std::size_t size = res.size();
+        res = task("combine", [&] { return _details::combine(cfunc, std::move(res)); });
+        stats_.add_records(stats_.stage("combine"), size, res.size());
+        budget_.release(bytes - std::min(bytes, common::records_memory(res)));
+      }
+      return res;
+    };
+    core::mapper<std::vector<MAPPER_OUT_TYPE>, MAPPER_OUT_TYPE, decltype(merge)> merger(merge);
+    std::vector<std::vector<MAPPER_OUT_TYPE>> rsplitted = exec_stage("merge", merger, ranges);
+
+    if (_details::has_combiner(cfunc)) {
+      stage_timer timer(stats_, stats_.stage("combine"));
+      auto count = [&rsplitted] {
+        std::size_t res = 0;
+        for (const std::vector<MAPPER_OUT_TYPE>& range : rsplitted)
+          res += range.size();
+        return res;
+      };
+      std::size_t size = count();
+      join_spread(rsplitted, cfunc);
+      stats_.add_records(stats_.stage("combine"), size, count());
+    }
+    return rsplitted;
+  }
+
+  template <class MFUNC, class RFUNC>
+  std::vector<REDUCER_OUT_TYPE> run_spill(std::vector<std::vector<DATA_TYPE>>&& splitted,
+                                          MFUNC& mfunc, RFUNC& rfunc) {
+    common::spill_dir dir(spill_path_);
+    std::mutex runs_mtx;
+    struct run_file {
+      std::string path;
+      std::size_t count;
+      /** @brief Estimated cost of the records. */
+      std::size_t weight;
+      /** @brief Bytes the records take in memory once they are read back. */
+      std::size_t bytes;
+    };
+    std::vector<run_file> runs;
+    /* bytes of the runs kept in memory, they stay charged until the merge */
+    std::atomic<std::size_t> kept{0};
+    std::size_t keep_budget = budget_.limit() / 2;
+    if (spill_budget_ != 0 && (keep_budget == 0 || spill_budget_ < keep_budget))
+      keep_budget = spill_budget_;
+    if (keep_budget == 0)
+      keep_budget = std::numeric_limits<std::size_t>::max();
+
+    /* Run MAP in batches of records, so that a task buffers about its share of the budget;
+       a batch waits for its share before it is mapped, is sorted and kept in memory up to the
+       spill budget or half of the memory limit, the other half is left to the batches in
+       flight and to the merge and reduce stages, and spilled beyond */
+    const std::size_t batch_bytes = worker_budget();
+    auto map_spill = [&](std::vector<DATA_TYPE>&& arg) {
+      std::vector<std::vector<MAPPER_OUT_TYPE>> res;
+      _details::batch_sizer sizer(batch_bytes);
+      for (std::size_t pos = 0; pos != arg.size();) {
+        std::size_t num = std::min(sizer.next(), arg.size() - pos);
+        common::memory_budget::lease batch = budget_.acquire(sizer.estimate(num));
+        auto first = std::make_move_iterator(arg.begin() + pos);
+        std::vector<MAPPER_OUT_TYPE> out = mfunc(std::vector<DATA_TYPE>(first, first + num));
+        pos += num;
+
+        batch.resize(common::records_memory(out) + common::sort_memory(out));
+        sizer.add(num, batch.bytes());
+        sort_run(out);
+        std::size_t bytes = common::records_memory(out);
+        batch.resize(bytes);
+
+        if (kept.fetch_add(bytes) + bytes <= keep_budget) {
+          batch.detach();
+          res.push_back(std::move(out));
+          continue;
+        }
+
+        kept -= bytes;
+        std::string path = dir.make_path("map");
+        std::size_t count = task("spill", [&] { return common::write_run(out, path); });
+        stats_.add_records(stats_.stage("spill"), count, count, std::filesystem::file_size(path));
+        std::size_t weight = 0;
+        std::size_t read_bytes = 0;
+        for (const MAPPER_OUT_TYPE& obj : out) {
+          weight += common::record_weight(obj);
+          read_bytes += common::record_read_size(obj);
+        }
+        std::lock_guard<std::mutex> lock(runs_mtx);
+        runs.push_back(run_file{std::move(path), count, weight, read_bytes});
+      }
+      return res;
+    };
+    core::mapper<DATA_TYPE, std::vector<MAPPER_OUT_TYPE>, decltype(map_spill)> mapper(map_spill);
+    std::vector<std::vector<std::vector<MAPPER_OUT_TYPE>>> mres =
+        exec_stage("map", mapper, splitted);
+
+    /* Small budgets spill many runs, they are merged into bigger ones first so that the
+       final merge keeps few files open; a merge waits for the buffers of its files */
+    const std::size_t file_memory = common::file_extractor<MAPPER_OUT_TYPE>::memory;
+    const std::size_t fanin = std::clamp<std::size_t>(
+        budget_.limit() / 2 / file_memory, 4, 16);
+    while (runs.size() > fanin) {
+      std::vector<std::vector<run_file>> groups;
+      for (std::size_t i = 0; i < runs.size(); i += fanin)
+        groups.emplace_back(runs.begin() + i, runs.begin() + std::min(i + fanin, runs.size()));
+
+      auto merge_files = [this, &dir, file_memory](std::vector<run_file>&& group) {
+        common::memory_budget::lease buffers = budget_.acquire(group.size() * file_memory);
+        std::vector<common::run_source<MAPPER_OUT_TYPE>> sources;
+        run_file res{dir.make_path("map"), 0, 0, 0};
+        for (const run_file& run : group) {
+          sources.emplace_back(run.path);
+          res.count += run.count;
+          res.weight += run.weight;
+          res.bytes += run.bytes;
+        }
+
+        common::run_writer<MAPPER_OUT_TYPE> writer(res.path);
+        common::loser_tree<common::run_source<MAPPER_OUT_TYPE>> merged(std::move(sources));
+        while (merged.has_next()) {
+          check_stop();
+          writer.write(merged.extract());
+        }
+        writer.close();
+        stats_.add_records(stats_.stage("spill_merge"), res.count, res.count,
+                           std::filesystem::file_size(res.path));
+        for (const run_file& run : group)
+          std::filesystem::remove(run.path);
+        return std::vector<run_file>{std::move(res)};
+      };
+      core::mapper<run_file, run_file, decltype(merge_files)> merger(merge_files);
+      runs.clear();
+      for (std::vector<run_file>& merged : exec_stage("spill_merge", merger, groups))
+        runs.push_back(std::move(merged.front()));
+    }
+
+    /* MERGE as a stream of in-memory and on-disk runs */
+    budget_.reset_peak();
+    std::optional<stage_timer> merge_timer(std::in_place, stats_, stats_.stage("merge"));
+    std::optional<common::memory_budget::lease> buffers(
+        std::in_place, budget_.acquire(runs.size() * file_memory));
+    std::size_t total = 0;
+    std::size_t total_weight = 0;
+    std::vector<common::run_source<MAPPER_OUT_TYPE>> sources;
+    for (std::vector<std::vector<MAPPER_OUT_TYPE>>& kept_runs : mres) {
+      for (std::vector<MAPPER_OUT_TYPE>& vec : kept_runs) {
+        total += vec.size();
+        for (const MAPPER_OUT_TYPE& obj : vec)
+          total_weight += common::record_weight(obj);
+        sources.emplace_back(std::move(vec));
+      }
+    }
+    for (const run_file& run : runs) {
+      total += run.count;
+      total_weight += run.weight;
+      sources.emplace_back(run.path);
+    }
+
+    /* Split for reducing by weight, a key range is closed only between two different keys;
+       also by the bytes the range takes once it is read back, so that every worker can hold
+       its range within the budget */
+    std::size_t num_cluster = (total_weight / rnum_) + (total_weight % rnum_ ? 1 : 0);
+    std::size_t range_limit = batch_bytes;
+    std::size_t weight = 0;
+    std::vector<std::vector<run_file>> rsplitted;
+    std::optional<common::run_writer<MAPPER_OUT_TYPE>> writer;
+
+    common::loser_tree<common::run_source<MAPPER_OUT_TYPE>> merged(std::move(sources));
+    while (merged.has_next()) {
+      check_stop();
+      MAPPER_OUT_TYPE obj = merged.extract();
+      if (!writer) {
+        rsplitted.push_back({run_file{dir.make_path("reduce"), 0, 0, 0}});
+        writer.emplace(rsplitted.back().front().path);
+      }
+      writer->write(obj);
+      weight += common::record_weight(obj);
+      run_file& range = rsplitted.back().front();
+      ++range.count;
+      range.bytes += common::record_read_size(obj);
+
+      bool full = weight >= num_cluster || (range_limit != 0 && range.bytes >= range_limit);
+      if (full && (!merged.has_next() || merged.val() != obj)) {
+        writer->close();
+        writer.reset();
+        weight = 0;
+      }
+    }
+    if (writer)
+      writer->close();
+    stats_.add_records(stats_.stage("merge"), total, total);
+    buffers.reset();
+    merge_timer.reset();
+    /* the in-memory runs are merged and freed with the sources */
+    budget_.release(kept);
+    stats_.add_memory(stats_.stage("merge"), budget_.reset_peak());
+
+    /* Run REDUCE, every task reads its own key range into its own arena and waits for the
+       bytes of the range; the result is copied out, so the arena is freed with the task */
+    common::string_arena& results = task_arena();
+    auto read_reduce = [&](std::vector<run_file>&& arg) {
+      const run_file& range = arg.front();
+      common::memory_budget::lease bytes = budget_.acquire(range.bytes);
+      common::string_arena arena;
+      std::vector<MAPPER_OUT_TYPE> data = task("spill_read", [&] {
+        return common::read_run<MAPPER_OUT_TYPE>(range.path, arena);
+      });
+      stats_.add_records(stats_.stage("spill_read"), data.size(), data.size(),
+                         std::filesystem::file_size(range.path));
+      bytes.resize(common::records_memory(data) + arena.size());
+      return keep_result(rfunc(std::move(data)), arena, results);
+    };
+    core::reducer<run_file, REDUCER_OUT_TYPE, decltype(read_reduce)> reducer(read_reduce);
+    return exec_stage("reduce", reducer, rsplitted);
+  }
+
+  /**
+   * @brief Copy the result of a reduce task out of the arena of its input.
+   * @details The result may view the arena; it is read back into the arena of
+   * the results of the job, or, if it can not be serialized, the arena is kept.
+   * @param [in] res - result of the reduce task.
+   * @param [in] arena - arena of the input of the task.
+   * @param [in] results - arena of the results of the job.
+   * @return Result that outlives the arena of the input.
+   */
+  REDUCER_OUT_TYPE keep_result(REDUCER_OUT_TYPE&& res, common::string_arena& arena,
+                               common::string_arena& results) {
+    if constexpr (common::is_serializable<REDUCER_OUT_TYPE>) {
+      std::stringstream buf;
+      common::serializer<REDUCER_OUT_TYPE>::write(buf, res);
+      std::lock_guard<std::mutex> lock(arenas_mtx_);
+      return *common::serializer<REDUCER_OUT_TYPE>::read(buf, results);
+    }
+    else {
+      std::lock_guard<std::mutex> lock(arenas_mtx_);
+      arenas_.push_back(std::move(arena));
+      return std::move(res);
+    }
+  }
+
+  /** @brief Start the own pool again if "run_processes" has stopped it. */
+  void start_pool() {
+    if (pool_)
+      return;
+    own_pool_ = std::make_unique<thread_pool>(std::max(mnum_, rnum_), where_);
+    pool_ = own_pool_.get();
+  }
+
+  /**
+   * @brief Get the bytes of records a worker of the spilling shuffle may hold at once.
+   * @return Share of the spill budget or of half of the memory limit, the smaller one.
+   */
+  std::size_t worker_budget() const noexcept {
+    std::size_t res = budget_.limit() / 2;
+    if (spill_budget_ != 0 && (res == 0 || spill_budget_ < res))
+      res = spill_budget_;
+    return std::max<std::size_t>(res / pool_->size(), 1);
+  }
+
+  /**
+   * @brief Final combine of the keys spread over several ranges.
+   * @details The elements of a key that continue the previous range are moved
+   * to it and combined there, emptied ranges are removed.
+   * @param [in,out] ranges - merged and combined ranges.
+   * @param [in] cfunc - combine function.
+   */
+  template <class CFUNC>
+  static void join_spread(std::vector<std::vector<MAPPER_OUT_TYPE>>& ranges, const CFUNC& cfunc) {
+    std::size_t dst = 0;
+    for (std::size_t i = 1; i < ranges.size(); ++i) {
+      std::vector<MAPPER_OUT_TYPE>& head = ranges[dst];
+      std::vector<MAPPER_OUT_TYPE>& cur = ranges[i];
+      if (head.empty()) {
+        dst = i;
+        continue;
+      }
+
+      auto last = std::find_if(cur.begin(), cur.end(),
+                               [&head](const MAPPER_OUT_TYPE& obj) { return obj != head.back(); });
+      if (last != cur.begin()) {
+        std::move(cur.begin(), last, std::back_inserter(head));
+        cur.erase(cur.begin(), last);
+        head = _details::combine(cfunc, std::move(head));
+      }
+      if (!cur.empty())
+        dst = i;
+    }
+
+    auto is_empty = [](const std::vector<MAPPER_OUT_TYPE>& vec) { return vec.empty(); };
+    ranges.erase(std::remove_if(ranges.begin(), ranges.end(), is_empty), ranges.end());
+  }
+
+  /** @brief Get a new arena that lives until the next job. */
+  common::string_arena& task_arena() {
+    std::lock_guard<std::mutex> lock(arenas_mtx_);
+    return arenas_.emplace_back();
+  }
+
+  template <class MFUNC, class RFUNC>
+  std::vector<REDUCER_OUT_TYPE> run_hash(std::vector<std::vector<DATA_TYPE>>&& splitted,
+                                         MFUNC& mfunc, RFUNC& rfunc) {
+    using bucket_t = std::vector<MAPPER_OUT_TYPE>;
+
+    /* Run MAP, every task routes its output into "rnum" buckets and sorts them */
+    auto map_route = [this, &mfunc](std::vector<DATA_TYPE>&& arg) {
+      std::vector<bucket_t> res =
+          checkpointed(std::move(arg), [this, &mfunc](std::vector<DATA_TYPE>&& part) {
+            std::vector<bucket_t> buckets = partition(mfunc(std::move(part)));
+            for (bucket_t& bucket : buckets)
+              sort_run(bucket);
+            return buckets;
+          });
+      std::size_t bytes = 0;
+      for (const bucket_t& bucket : res)
+        bytes += common::records_memory(bucket);
+      budget_.charge(bytes, "map output");
+      return res;
+    };
+    core::mapper<DATA_TYPE, bucket_t, decltype(map_route)> mapper(map_route);
+    std::vector<std::vector<bucket_t>> mres = exec_stage("map", mapper, splitted);
+
+    /* Gather the buckets of every reducer, only vectors are moved here */
+    std::vector<std::vector<bucket_t>> rgathered(rnum_);
+    for (std::vector<bucket_t>& buckets : mres) {
+      for (std::size_t i = 0; i != buckets.size(); ++i) {
+        if (!buckets[i].empty())
+          rgathered[i].push_back(std::move(buckets[i]));
+      }
+    }
+    rgathered.erase(std::remove_if(rgathered.begin(), rgathered.end(),
+                                   [](const std::vector<bucket_t>& vec) { return vec.empty(); }),
+                    rgathered.end());
+
+    /* Run REDUCE, every task merges the sorted parts of its own bucket */
+    auto merge_reduce = [this, &rfunc](std::vector<bucket_t>&& arg) {
+      std::size_t bytes = 0;
+      for (const bucket_t& part : arg)
+        bytes += common::records_memory(part);
+      budget_.charge(bytes, "merge of a bucket");
+
+      bucket_t merged = merge_task(std::move(arg));
+      budget_.release(bytes);
+      return rfunc(std::move(merged));
+    };
+    core::reducer<bucket_t, REDUCER_OUT_TYPE, decltype(merge_reduce)> reducer(merge_reduce);
+    return exec_stage("reduce", reducer, rgathered);
+  }
+
+  /**
+   * @brief Wrap the map and combine functions into one map task.
+   * @details The combiner is a part of the map task; both functions add their
+   * time and records to the statistics.
+   */
+  template <class MFUNC, class CFUNC>
+  auto map_task(MFUNC mfunc, CFUNC cfunc) {
+    return [this, mfunc = std::move(mfunc),
+            cfunc = std::move(cfunc)](std::vector<DATA_TYPE>&& arg) {
+      auto start = std::chrono::steady_clock::now();
+      /* the part was allocated by the splitting thread, the first touch places the copy here */
+      if (pool_->nodes() > 1)
+        arg = std::vector<DATA_TYPE>(std::make_move_iterator(arg.begin()),
+                                     std::make_move_iterator(arg.end()));
+
+      std::size_t size = arg.size();
+      std::vector<MAPPER_OUT_TYPE> res = task("map", [&] { return mfunc(std::move(arg)); });
+      stats_.add_records(stats_.stage("map"), size, res.size(), common::records_size(res));
+      add_node_task("map", size, start);
+
+      if (_details::has_combiner(cfunc)) {
+        size = res.size();
+        res = task("combine", [&] { return _details::combine(cfunc, std::move(res)); });
+        stats_.add_records(stats_.stage("combine"), size, res.size(), common::records_size(res));
+      }
+      return res;
+    };
+  }
+
+  /**
+   * @brief Wrap the reduce function into a reduce task that adds its records to the statistics.
+   * @details The input of the task is released from the memory budget once it is reduced.
+   */
+  template <class RFUNC>
+  auto reduce_task(RFUNC rfunc) {
+    return [this, rfunc = std::move(rfunc)](std::vector<MAPPER_OUT_TYPE>&& arg) {
+      auto start = std::chrono::steady_clock::now();
+      std::size_t size = arg.size();
+      std::size_t bytes = common::records_memory(arg);
+      REDUCER_OUT_TYPE res = task("reduce", [&] { return rfunc(std::move(arg)); });
+      budget_.release(bytes);
+      stats_.add_records(stats_.stage("reduce"), size, 1);
+      add_node_task("reduce", size, start);
+      return res;
+    };
+  }
+
+  /** @brief Add the task started at "start" to the stage on the NUMA node of the worker. */
+  void add_node_task(const std::string& name, std::size_t records,
+                     std::chrono::steady_clock::time_point start) {
+    std::chrono::duration<double, std::milli> wall = std::chrono::steady_clock::now() - start;
+    stats_.add_node_task(stats_.stage(name), thread_pool::current_node(), records, wall.count());
+  }
+
+  /**
+   * @brief Run a map task through the checkpoint of the job.
+   * @details The output of an input part mapped by a previous run is read back,
+   * the output of a new one is saved before it is returned.
+   * @param [in] arg - input part of the task.
+   * @param [in] func - map task, returns the sorted output parts.
+   * @return Sorted output parts.
+   */
+  template <class F>
+  std::vector<std::vector<MAPPER_OUT_TYPE>> checkpointed(std::vector<DATA_TYPE>&& arg, F&& func) {
+    if (!checkpoint_)
+      return func(std::move(arg));
+
+    std::uint64_t key = common::records_fingerprint(arg);
+    std::vector<std::vector<MAPPER_OUT_TYPE>> res;
+    if (task("checkpoint_read", [&] { return checkpoint_->load(key, res, task_arena()); })) {
+      std::size_t count = 0;
+      for (const std::vector<MAPPER_OUT_TYPE>& part : res)
+        count += part.size();
+      stats_.add_records(stats_.stage("checkpoint_read"), arg.size(), count);
+      return res;
+    }
+
+    std::size_t size = arg.size();
+    res = func(std::move(arg));
+    task("checkpoint_write", [&] { checkpoint_->save(key, res); });
+    std::size_t count = 0;
+    for (const std::vector<MAPPER_OUT_TYPE>& part : res)
+      count += part.size();
+    stats_.add_records(stats_.stage("checkpoint_write"), size, count);
+    return res;
+  }
+
+  /** @brief Sort the output of a map task. */
+  void sort_run(std::vector<MAPPER_OUT_TYPE>& data) {
+    stage_timer timer(stats_, stats_.stage("sort"), stage_timer::kind::task);
+    common::sort_records(data, [this] {
+      if (control_)
+        control_->check();
+    });
+    stats_.add_records(stats_.stage("sort"), data.size(), data.size());
+  }
+
+  /** @brief Merge the sorted runs in a task of the "merge" stage. */
+  std::vector<MAPPER_OUT_TYPE> merge_task(std::vector<std::vector<MAPPER_OUT_TYPE>>&& runs) {
+    std::size_t size = 0;
+    for (const std::vector<MAPPER_OUT_TYPE>& run : runs)
+      size += run.size();
+    std::vector<MAPPER_OUT_TYPE> res = task("merge", [&runs] {
+      return common::merge_tournament<MAPPER_OUT_TYPE>(std::move(runs));
+    });
+    stats_.add_records(stats_.stage("merge"), size, res.size());
+    return res;
+  }
+
+  /** @brief Route the map output into "rnum" buckets by hash in a task of the "partition" stage. */
+  std::vector<std::vector<MAPPER_OUT_TYPE>> partition(std::vector<MAPPER_OUT_TYPE>&& data) {
+    std::size_t size = data.size();
+    std::vector<std::vector<MAPPER_OUT_TYPE>> res =
+        task("partition", [&] { return common::split_hash(std::move(data), rnum_); });
+    stats_.add_records(stats_.stage("partition"), size, size);
+    return res;
+  }
+
+  /** @brief Run the final function on the results of the reduce tasks. */
+  template <class OFUNC>
+  OUT_TYPE output(OFUNC& ofunc, std::vector<REDUCER_OUT_TYPE>&& rres) {
+    stage_timer timer(stats_, stats_.stage("output"));
+    stats_.add_records(stats_.stage("output"), rres.size(), 1);
     return ofunc(std::move(rres));
   }
+
+  /**
+   * @brief Run a part of a task and add its time to the tasks of the stage.
+   * @throw job_cancelled - if the job must stop, the part is not run.
+   */
+  template <class F>
+  auto task(const std::string& name, F&& func) {
+    if (control_)
+      control_->check();
+    stage_timer timer(stats_, stats_.stage(name), stage_timer::kind::task);
+    return func();
+  }
+
+  /**
+   * @brief Run the tasks of the stage on the pool, add the time and the peak memory of the
+   * whole stage.
+   * @throw job_cancelled - if the job must stop, the stage is not run.
+   */
+  template <class EXEC, class IN>
+  auto exec_stage(const std::string& name, EXEC& exec, std::vector<IN>& input) {
+    if (control_)
+      control_->check();
+    budget_.reset_peak();
+    auto res = [&] {
+      stage_timer timer(stats_, stats_.stage(name));
+      return exec.exec(std::move(input), *pool_);
+    }();
+    stats_.add_memory(stats_.stage(name), budget_.reset_peak());
+    return res;
+  }
 };
 
 } /* core:: */
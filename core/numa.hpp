@@ -0,0 +1,159 @@
+/**
+ * @file numa.hpp
+ * @brief Definition of the class "NUMA Topology".
+ *
+ * @author Maxim <john.jasper.doe@gmail.com>
+ * @date 2020
+ */
+
+#ifndef CORE_NUMA_HPP_
+#define CORE_NUMA_HPP_
+
+#include <sched.h>
+
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/** @brief The namespace of the MAP REDUCE project */
+namespace yamr {
+/** @brief The namespace of the Core */
+namespace core {
+
+/** @brief The namespace to hide the implementation. */
+namespace _details {
+
+/**
+ * @brief Parse a CPU list of the sysfs, e.g. "0-3,8-11".
+ * @param [in] str - CPU list.
+ * @return CPU numbers, ascending; malformed parts are skipped.
+ */
+inline std::vector<std::size_t> parse_cpulist(const std::string& str) {
+  std::vector<std::size_t> res;
+  std::size_t pos = 0;
+  while (pos < str.size()) {
+    std::size_t end = std::min(str.find(',', pos), str.size());
+    std::string part = str.substr(pos, end - pos);
+    pos = end + 1;
+
+    part.erase(std::remove_if(part.begin(), part.end(),
+                              [](unsigned char c) { return std::isspace(c) != 0; }),
+               part.end());
+    if (part.empty() || !std::isdigit(static_cast<unsigned char>(part.front())))
+      continue;
+
+    std::size_t dash = part.find('-');
+    std::size_t first = std::stoul(part.substr(0, dash));
+    std::size_t last = first;
+    if (dash != std::string::npos && dash + 1 < part.size())
+      last = std::stoul(part.substr(dash + 1));
+    for (std::size_t cpu = first; cpu <= last; ++cpu)
+      res.push_back(cpu);
+  }
+
+  std::sort(res.begin(), res.end());
+  res.erase(std::unique(res.begin(), res.end()), res.end());
+  return res;
+}
+
+/** @brief CPUs the process is allowed to run on. */
+inline std::vector<std::size_t> allowed_cpus() {
+  std::vector<std::size_t> res;
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  if (::sched_getaffinity(0, sizeof(cpus), &cpus) == 0) {
+    for (std::size_t cpu = 0; cpu != CPU_SETSIZE; ++cpu) {
+      if (CPU_ISSET(cpu, &cpus))
+        res.push_back(cpu);
+    }
+  }
+  if (res.empty()) {
+    for (std::size_t cpu = 0; cpu != std::max(1u, std::thread::hardware_concurrency()); ++cpu)
+      res.push_back(cpu);
+  }
+  return res;
+}
+
+} /* _details:: */
+
+/**
+ * @brief Class "NUMA Topology".
+ *
+ * @details
+ * CPUs of every NUMA node the process may run on, as described by
+ * "/sys/devices/system/node". Nodes without allowed CPUs are dropped, so the
+ * node numbers are dense indices, not the kernel ids. A system without the
+ * sysfs description is one node of all allowed CPUs.
+ */
+class numa_topology {
+  std::vector<std::vector<std::size_t>> nodes_;
+
+public:
+  /**
+   * @brief Read the topology of the system.
+   * @param [in] root - directory of the node descriptions.
+   * @return Topology, at least one node.
+   */
+  static numa_topology detect(const std::string& root = "/sys/devices/system/node") {
+    namespace fs = std::filesystem;
+
+    std::vector<std::size_t> allowed = _details::allowed_cpus();
+    std::vector<std::pair<std::size_t, std::vector<std::size_t>>> found;
+
+    std::error_code ec;
+    for (fs::directory_iterator it(root, ec), end; !ec && it != end; it.increment(ec)) {
+      std::string name = it->path().filename().string();
+      if (name.size() <= 4 || name.compare(0, 4, "node") != 0 ||
+          !std::all_of(name.begin() + 4, name.end(),
+                       [](unsigned char c) { return std::isdigit(c) != 0; }))
+        continue;
+
+      std::ifstream is(it->path() / "cpulist");
+      std::string list;
+      if (!std::getline(is, list))
+        continue;
+
+      std::vector<std::size_t> cpus;
+      for (std::size_t cpu : _details::parse_cpulist(list)) {
+        if (std::binary_search(allowed.begin(), allowed.end(), cpu))
+          cpus.push_back(cpu);
+      }
+      if (!cpus.empty())
+        found.emplace_back(std::stoul(name.substr(4)), std::move(cpus));
+    }
+
+    std::sort(found.begin(), found.end());
+    numa_topology res;
+    for (auto& node : found)
+      res.nodes_.push_back(std::move(node.second));
+    if (res.nodes_.empty())
+      res.nodes_.push_back(std::move(allowed));
+    return res;
+  }
+
+  /**
+   * @brief Get number of nodes.
+   * @return Number of nodes.
+   */
+  std::size_t size() const noexcept {
+    return nodes_.size();
+  }
+
+  /**
+   * @brief Get the CPUs of the node.
+   * @param [in] node - node index.
+   * @return CPU numbers, ascending.
+   */
+  const std::vector<std::size_t>& cpus(std::size_t node) const noexcept {
+    return nodes_[node];
+  }
+};
+
+} /* core:: */
+} /* yamr:: */
+
+#endif /* CORE_NUMA_HPP_ */
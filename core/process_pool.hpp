@@ -0,0 +1,302 @@
+/**
+ * @file process_pool.hpp
+ * @brief Definition of the class "Process Pool".
+ *
+ * @author Maxim <john.jasper.doe@gmail.com>
+ * @date 2020
+ */
+
+#ifndef CORE_PROCESS_POOL_HPP_
+#define CORE_PROCESS_POOL_HPP_
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+
+/** @brief The namespace of the MAP REDUCE project */
+namespace yamr {
+/** @brief The namespace of the Core */
+namespace core {
+
+/**
+ * @brief Class "Process Pool".
+ *
+ * @details
+ * The coordinator forks worker processes and talks to every worker over its
+ * own stream socket with a line protocol: the coordinator sends one command
+ * per line, the worker answers it with one line, "ok[ <text>]" or
+ * "error <text>". Workers know nothing but the socket and the handler of the
+ * commands, so the same protocol can be spoken over a TCP connection to a
+ * worker on another host.
+ *
+ * A worker that dies (e.g. crashes on a bad record) is replaced by a new one
+ * and its command is given to another worker; a command that fails or kills
+ * its worker too many times fails the whole batch.
+ *
+ * @note The workers are forked from the calling thread, they see the memory
+ * of the coordinator at the time of the fork, but no other threads. So the
+ * process must have no other threads while the pool lives, a dead worker is
+ * forked again in the middle of "run": a lock held by another thread at the
+ * fork (e.g. of "malloc") would stay locked in the worker. The handler must
+ * not use the threads, locks or pools of the coordinator.
+ */
+class process_pool {
+public:
+  /** @brief Handler of a command in the worker, returns the answer without "ok". */
+  using handler_t = std::function<std::string(const std::string&)>;
+
+private:
+  struct worker {
+    pid_t pid{-1};
+    int fd{-1};
+    /** @brief Buffer of the incomplete answer. */
+    std::string buf;
+    /** @brief Index of the running command. */
+    std::optional<std::size_t> cmd;
+  };
+
+  handler_t handler_;
+  std::vector<worker> workers_;
+
+public:
+  /**
+   * @brief Constructor with param.
+   * @param [in] size - number of worker processes.
+   * @param [in] handler - handler of the commands, is run in the workers.
+   * @throw std::system_error - if a worker can not be started.
+   */
+  process_pool(std::size_t size, handler_t handler)
+    : handler_(std::move(handler)), workers_(std::max<std::size_t>(size, 1)) {
+    for (worker& w : workers_)
+      spawn(w);
+  }
+
+  process_pool(const process_pool&) = delete;
+  process_pool& operator=(const process_pool&) = delete;
+
+  ~process_pool() {
+    for (worker& w : workers_)
+      stop(w);
+  }
+
+  /**
+   * @brief Get number of worker processes.
+   * @return Number of workers.
+   */
+  std::size_t size() const noexcept {
+    return workers_.size();
+  }
+
+  /**
+   * @brief Run the commands on the workers.
+   * @param [in] cmds - commands, one line each.
+   * @param [in] attempts - max number of attempts of one command.
+   * @return Answers of the commands without "ok", in the order of the commands.
+   * @throw std::runtime_error - if a command failed "attempts" times.
+   */
+  std::vector<std::string> run(const std::vector<std::string>& cmds, std::size_t attempts = 3) {
+    std::vector<std::string> res(cmds.size());
+    std::vector<std::size_t> tries(cmds.size(), 0);
+    std::deque<std::size_t> pending;
+    for (std::size_t i = 0; i != cmds.size(); ++i)
+      pending.push_back(i);
+    std::size_t left = cmds.size();
+
+    auto retry = [&](std::size_t idx, const std::string& why) {
+      if (++tries[idx] >= attempts)
+        throw std::runtime_error("Command \"" + cmds[idx] + "\" failed: " + why);
+      pending.push_front(idx);
+    };
+
+    while (left != 0) {
+      /* give the pending commands to the idle workers */
+      for (worker& w : workers_) {
+        if (w.cmd || pending.empty())
+          continue;
+        std::size_t idx = pending.front();
+        pending.pop_front();
+        w.cmd = idx;
+        if (!send_line(w.fd, cmds[idx])) {
+          w.cmd.reset();
+          restart(w);
+          retry(idx, "worker is lost");
+        }
+      }
+
+      std::vector<pollfd> fds;
+      for (const worker& w : workers_)
+        fds.push_back(pollfd{w.fd, POLLIN, 0});
+      if (::poll(fds.data(), fds.size(), -1) == -1) {
+        if (errno == EINTR)
+          continue;
+        throw std::system_error(errno, std::generic_category(), "Can not poll workers");
+      }
+
+      for (std::size_t i = 0; i != workers_.size(); ++i) {
+        if (fds[i].revents == 0)
+          continue;
+
+        worker& w = workers_[i];
+        std::optional<std::string> line = read_line(w);
+        if (!line) {
+          /* the worker is dead, the command goes to another one */
+          std::optional<std::size_t> idx = w.cmd;
+          w.cmd.reset();
+          restart(w);
+          if (idx)
+            retry(*idx, "worker died");
+          continue;
+        }
+        if (!w.cmd) {
+          /* an answer without a command breaks the protocol, the worker is replaced */
+          restart(w);
+          continue;
+        }
+
+        std::size_t idx = *w.cmd;
+        w.cmd.reset();
+        if (line->compare(0, 2, "ok") == 0) {
+          res[idx] = line->size() > 3 ? line->substr(3) : std::string{};
+          --left;
+        }
+        else
+          retry(idx, *line);
+      }
+    }
+
+    return res;
+  }
+
+private:
+  /** @brief Fork a worker. */
+  void spawn(worker& w) {
+    int sv[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == -1)
+      throw std::system_error(errno, std::generic_category(), "Can not create socket");
+
+    pid_t pid = ::fork();
+    if (pid == -1) {
+      int err = errno;
+      ::close(sv[0]);
+      ::close(sv[1]);
+      throw std::system_error(err, std::generic_category(), "Can not fork worker");
+    }
+
+    if (pid == 0) {
+      ::close(sv[0]);
+      for (const worker& other : workers_) {
+        if (other.fd != -1)
+          ::close(other.fd);
+      }
+      serve(sv[1]);
+      ::_exit(0);
+    }
+
+    ::close(sv[1]);
+    w = worker{};
+    w.pid = pid;
+    w.fd = sv[0];
+  }
+
+  /** @brief Stop the worker and wait for it. */
+  void stop(worker& w) noexcept {
+    if (w.fd != -1) {
+      send_line(w.fd, "quit");
+      ::close(w.fd);
+    }
+    if (w.pid != -1)
+      ::waitpid(w.pid, nullptr, 0);
+    w = worker{};
+  }
+
+  /** @brief Replace the worker by a new one. */
+  void restart(worker& w) {
+    if (w.fd != -1)
+      ::close(w.fd);
+    if (w.pid != -1) {
+      ::kill(w.pid, SIGKILL);
+      ::waitpid(w.pid, nullptr, 0);
+    }
+    w = worker{};
+    spawn(w);
+  }
+
+  /** @brief Command loop of the worker process. */
+  void serve(int fd) noexcept {
+    worker self;
+    self.fd = fd;
+    while (std::optional<std::string> cmd = read_line(self)) {
+      if (*cmd == "quit")
+        break;
+
+      std::string answer;
+      try {
+        std::string text = handler_(*cmd);
+        answer = text.empty() ? "ok" : "ok " + text;
+      }
+      catch (const std::exception& e) {
+        answer = std::string("error ") + e.what();
+      }
+      if (!send_line(fd, answer))
+        break;
+    }
+    ::close(fd);
+  }
+
+  /** @brief Send one line, "false" if the peer is gone. */
+  static bool send_line(int fd, const std::string& line) noexcept {
+    std::string msg = line + '\n';
+    std::size_t sent = 0;
+    while (sent != msg.size()) {
+      ssize_t n = ::send(fd, msg.data() + sent, msg.size() - sent, MSG_NOSIGNAL);
+      if (n == -1 && errno == EINTR)
+        continue;
+      if (n <= 0)
+        return false;
+      sent += static_cast<std::size_t>(n);
+    }
+    return true;
+  }
+
+  /**
+   * @brief Read one line of the worker.
+   * @details Blocks until a whole line is read, the buffer keeps the rest.
+   * @return Line without the line feed, empty if the peer is gone.
+   */
+  static std::optional<std::string> read_line(worker& w) {
+    for (;;) {
+      std::size_t pos = w.buf.find('\n');
+      if (pos != std::string::npos) {
+        std::string line = w.buf.substr(0, pos);
+        w.buf.erase(0, pos + 1);
+        return line;
+      }
+
+      char chunk[4096];
+      ssize_t n = ::read(w.fd, chunk, sizeof(chunk));
+      if (n == -1 && errno == EINTR)
+        continue;
+      if (n <= 0)
+        return std::nullopt;
+      w.buf.append(chunk, static_cast<std::size_t>(n));
+    }
+  }
+};
+
+} /* core:: */
+} /* yamr:: */
+
+#endif /* CORE_PROCESS_POOL_HPP_ */
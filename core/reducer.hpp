@@ -10,12 +10,16 @@
 #define CORE_REDUCER_HPP_
 
 #include <algorithm>
+#include <exception>
 #include <functional>
 #include <future>
 #include <set>
-#include <thread>
+#include <utility>
 #include <vector>
 
+#include "job_control.hpp"
+#include "thread_pool.hpp"
+
 /** @brief The namespace of the MAP REDUCE project */
 namespace yamr {
 /** @brief The namespace of the Core */
@@ -25,48 +29,52 @@ namespace core {
 template <class DATA_TYPE, class OUT_TYPE>
 using rfunc_ptr_t = std::function<OUT_TYPE(std::vector<DATA_TYPE>&&)>;
 
-/** @brief The reducer class */
-template <class DATA_TYPE, class OUT_TYPE>
+/**
+ * @brief The reducer class
+ * @tparam FUNC - type of the reduce function, any callable that takes the part
+ * of the input; a lambda or a functor is called directly, without type erasure.
+ */
+template <class DATA_TYPE, class OUT_TYPE, class FUNC = rfunc_ptr_t<DATA_TYPE, OUT_TYPE>>
 class reducer {
-  using thread_ptr_t = std::unique_ptr<std::thread, std::function<void(std::thread*)>>;
-
   /** @brief Reduce function. */
-  rfunc_ptr_t<DATA_TYPE, OUT_TYPE> function_;
+  FUNC function_;
 
 public:
-  explicit reducer(rfunc_ptr_t<DATA_TYPE, OUT_TYPE> reduce_func) noexcept
-    : function_{reduce_func} {}
+  explicit reducer(FUNC reduce_func) noexcept : function_{std::move(reduce_func)} {}
 
   /**
    * @brief Function to execute.
-   * @param [in] input - input data.
+   * @param [in] input - input data, one task per part.
+   * @param [in] pool - pool to run the tasks on, task "i" prefers the NUMA node "i % nodes".
    * @return Processed data.
+   * @throw The first error of the tasks, after all of them are finished.
    */
-  std::vector<OUT_TYPE> exec(std::vector<std::vector<DATA_TYPE>>&& input) noexcept {
+  std::vector<OUT_TYPE> exec(std::vector<std::vector<DATA_TYPE>>&& input,
+                             thread_pool& pool) {
     std::vector<OUT_TYPE> res;
 
-    std::vector<std::promise<OUT_TYPE>> promises(input.size());
     std::vector<std::future<OUT_TYPE>> futures;
-    for (size_t i = 0; i != promises.size(); ++i) {
-      futures.push_back(promises[i].get_future());
-    }
-
-    /* worker function */
-    auto worker = [this](std::promise<OUT_TYPE>&& promise, std::vector<DATA_TYPE>&& arg) {
-      OUT_TYPE res = function_(std::move(arg));
-      promise.set_value(std::move(res));
-    };
-
-    std::vector<thread_ptr_t> workers;
-    for (size_t i = 0; i != promises.size(); ++i) {
-      workers.emplace_back(
-          thread_ptr_t(new std::thread(worker, std::move(promises[i]), std::move(input[i])),
-                       [](std::thread* t) { t->join(); }));
+    for (size_t i = 0; i != input.size(); ++i) {
+      futures.push_back(pool.submit(
+          [this, arg = std::move(input[i])]() mutable { return function_(std::move(arg)); },
+          i));
     }
 
+    /* every task is waited for before an error is rethrown, they use the object;
+       a worker that runs a nested stage helps with the tasks meanwhile */
+    std::exception_ptr error;
     for (size_t i = 0; i != futures.size(); ++i) {
-      res.push_back(futures[i].get());
+      pool.wait(futures[i]);
+      try {
+        res.push_back(futures[i].get());
+      }
+      catch (...) {
+        if (!error)
+          error = std::current_exception();
+      }
     }
+    if (error)
+      std::rethrow_exception(error);
 
     return res;
   }
@@ -86,6 +94,7 @@ std::set<DATA_TYPE> counting_prefixes(std::vector<DATA_TYPE>&& prefixes) {
   auto prefixes_it = prefixes.begin();
 
   while (prefixes_it != prefixes.end()) {
+    check_stop();
     auto it = count_prefixes.find(*prefixes_it);
     if (it != count_prefixes.end()) {
       it->add_count(prefixes_it->count());
@@ -122,14 +131,27 @@ std::vector<DATA_TYPE> sort_desc_by_len(std::set<DATA_TYPE>&& data) {
   return res;
 }
 
+/**
+ * @brief The result of the reducers on no input: an empty element of no count.
+ * @tparam DATA_TYPE - Data type used.
+ */
+template <class DATA_TYPE>
+DATA_TYPE no_prefix() {
+  return DATA_TYPE(typename DATA_TYPE::value_type(), 0);
+}
+
 } /* _details:: */
 
 /**
  * @brief The reducer of function.
  * @tparam DATA_TYPE - Data type used.
+ * @param [in] prefixes - data, an empty element of no count is the result if it is empty.
  */
 template <class DATA_TYPE>
 DATA_TYPE reducer_func(std::vector<DATA_TYPE>&& prefixes) {
+  if (prefixes.empty())
+    return _details::no_prefix<DATA_TYPE>();
+
   std::set<DATA_TYPE> count_prefixes = _details::counting_prefixes(std::move(prefixes));
   std::vector<DATA_TYPE> desc_by_len = _details::sort_desc_by_len(std::move(count_prefixes));
 
@@ -144,6 +166,44 @@ DATA_TYPE reducer_func(std::vector<DATA_TYPE>&& prefixes) {
   }
 }
 
+/**
+ * @brief The reducer of function for sorted input.
+ *
+ * @details
+ * Finds the same element as "reducer_func" in one pass: equal elements are
+ * adjacent in sorted input, so every run of them is folded into its first
+ * element and compared with the best one so far. No tree is built and
+ * nothing is sorted again. Elements with a count greater than one are
+ * preferred, then longer ones; of equal candidates the first one wins.
+ *
+ * @tparam DATA_TYPE - Data type used.
+ * @param [in] prefixes - sorted data, an empty element of no count is the result if it is empty.
+ */
+template <class DATA_TYPE>
+DATA_TYPE sorted_reducer_func(std::vector<DATA_TYPE>&& prefixes) {
+  if (prefixes.empty())
+    return _details::no_prefix<DATA_TYPE>();
+
+  auto best = prefixes.begin();
+  bool best_shared = false;
+
+  for (auto first = prefixes.begin(); first != prefixes.end();) {
+    check_stop();
+    auto last = std::next(first);
+    for (; last != prefixes.end() && *last == *first; ++last)
+      first->add_count(last->count());
+
+    bool shared = first->count() > 1;
+    if ((shared && !best_shared) || (shared == best_shared && first->strlen() > best->strlen())) {
+      best = first;
+      best_shared = shared;
+    }
+    first = last;
+  }
+
+  return std::move(*best);
+}
+
 } /* core:: */
 } /* yamr:: */
 
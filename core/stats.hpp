@@ -0,0 +1,303 @@
+/**
+ * @file stats.hpp
+ * @brief Definition of the classes to collect the statistics of a job.
+ *
+ * @author Maxim <john.jasper.doe@gmail.com>
+ * @date 2020
+ */
+
+#ifndef CORE_STATS_HPP_
+#define CORE_STATS_HPP_
+
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <deque>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+
+/** @brief The namespace of the MAP REDUCE project */
+namespace yamr {
+/** @brief The namespace of the Core */
+namespace core {
+
+/** @brief Statistics of the tasks of a stage run on one NUMA node. */
+struct node_stats {
+  std::size_t tasks{0};
+  std::size_t records_in{0};
+  double task_total_ms{0};
+};
+
+/** @brief Statistics of one stage of a job. */
+struct stage_stats {
+  std::string name;
+  /** @brief Elapsed time, zero for the stages run inside the tasks of another stage. */
+  double wall_ms{0};
+  /**
+   * @brief CPU time of the calling thread and of all tasks of the stage.
+   * @details Only the own time of the stage: the time of the stages and tasks
+   * timed inside it on the same thread (e.g. the sort of a map task, or the
+   * tasks a waiting worker runs) is counted in their stages alone.
+   */
+  double cpu_ms{0};
+  std::size_t records_in{0};
+  std::size_t records_out{0};
+  /** @brief Serialized size of the output. */
+  std::size_t bytes_out{0};
+  std::size_t tasks{0};
+  double task_min_ms{0};
+  double task_max_ms{0};
+  double task_total_ms{0};
+  /**
+   * @brief Peak resident set size of the whole process at the end of the stage.
+   * @details The peak of the process so far, not of the stage: it includes the
+   * peaks of the stages and jobs before it.
+   */
+  long process_peak_rss_kb{0};
+  /** @brief Peak of the bytes of records held by the job during the stage. */
+  std::size_t mem_peak_bytes{0};
+  /** @brief Tasks by the NUMA node of their worker, empty if the stage does not count them. */
+  std::vector<node_stats> nodes;
+};
+
+/** @brief The namespace to hide the implementation. */
+namespace _details {
+
+/** @brief CPU time of the calling thread in milliseconds. */
+inline double thread_cpu_ms() noexcept {
+  timespec ts{};
+  ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return static_cast<double>(ts.tv_sec) * 1e3 + static_cast<double>(ts.tv_nsec) / 1e6;
+}
+
+/**
+ * @brief CPU time of the timers that have run inside the current one on the
+ * calling thread, in milliseconds.
+ */
+inline double& nested_cpu_ms() noexcept {
+  thread_local double res = 0;
+  return res;
+}
+
+/** @brief Peak resident set size of the process in KiB. */
+inline long peak_rss_kb() noexcept {
+  rusage usage{};
+  ::getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+} /* _details:: */
+
+/**
+ * @brief Class "Job Stats".
+ *
+ * @details
+ * Stages are found by name and keep their order of appearance. Statistics of
+ * the stages with the same name are summed up, so they accumulate over the
+ * jobs until "clear" is called. All methods are thread-safe; the references
+ * returned by "stage" stay valid until "clear".
+ */
+class job_stats {
+  mutable std::mutex mtx_;
+  std::deque<stage_stats> stages_;
+
+public:
+  /**
+   * @brief Get the stage, it is created if there is no such one.
+   * @param [in] name - name of the stage.
+   * @return Stage.
+   */
+  stage_stats& stage(const std::string& name) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto it = std::find_if(stages_.begin(), stages_.end(),
+                           [&name](const stage_stats& st) { return st.name == name; });
+    if (it != stages_.end())
+      return *it;
+    stage_stats& res = stages_.emplace_back();
+    res.name = name;
+    return res;
+  }
+
+  /**
+   * @brief Add a run of the whole stage.
+   * @param [in] st - stage.
+   * @param [in] wall_ms - elapsed time.
+   * @param [in] cpu_ms - CPU time of the calling thread.
+   */
+  void add_run(stage_stats& st, double wall_ms, double cpu_ms) {
+    long rss = _details::peak_rss_kb();
+    std::lock_guard<std::mutex> lock(mtx_);
+    st.wall_ms += wall_ms;
+    st.cpu_ms += cpu_ms;
+    st.process_peak_rss_kb = std::max(st.process_peak_rss_kb, rss);
+  }
+
+  /**
+   * @brief Add a task of the stage.
+   * @param [in] st - stage.
+   * @param [in] wall_ms - elapsed time of the task.
+   * @param [in] cpu_ms - CPU time of the task.
+   */
+  void add_task(stage_stats& st, double wall_ms, double cpu_ms) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    st.task_min_ms = st.tasks == 0 ? wall_ms : std::min(st.task_min_ms, wall_ms);
+    st.task_max_ms = std::max(st.task_max_ms, wall_ms);
+    st.task_total_ms += wall_ms;
+    st.cpu_ms += cpu_ms;
+    ++st.tasks;
+  }
+
+  /**
+   * @brief Add processed records.
+   * @param [in] st - stage.
+   * @param [in] in - number of input records.
+   * @param [in] out - number of output records.
+   * @param [in] bytes - serialized size of the output.
+   */
+  void add_records(stage_stats& st, std::size_t in, std::size_t out, std::size_t bytes = 0) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    st.records_in += in;
+    st.records_out += out;
+    st.bytes_out += bytes;
+  }
+
+  /**
+   * @brief Add the peak memory of a run of the stage.
+   * @param [in] st - stage.
+   * @param [in] bytes - peak of the bytes of records held by the job.
+   */
+  void add_memory(stage_stats& st, std::size_t bytes) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    st.mem_peak_bytes = std::max(st.mem_peak_bytes, bytes);
+  }
+
+  /**
+   * @brief Add a task of the stage run on the NUMA node.
+   * @param [in] st - stage.
+   * @param [in] node - node of the worker.
+   * @param [in] in - number of input records.
+   * @param [in] wall_ms - elapsed time of the task.
+   */
+  void add_node_task(stage_stats& st, std::size_t node, std::size_t in, double wall_ms) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (st.nodes.size() <= node)
+      st.nodes.resize(node + 1);
+    ++st.nodes[node].tasks;
+    st.nodes[node].records_in += in;
+    st.nodes[node].task_total_ms += wall_ms;
+  }
+
+  /**
+   * @brief Get a snapshot of the stages.
+   * @return Stages in the order of appearance.
+   */
+  std::vector<stage_stats> stages() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return std::vector<stage_stats>(stages_.begin(), stages_.end());
+  }
+
+  /** @brief Forget all stages. */
+  void clear() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    stages_.clear();
+  }
+
+  /**
+   * @brief Write the report as a JSON object.
+   * @param [in] os - output stream.
+   */
+  void write_json(std::ostream& os) const {
+    std::vector<stage_stats> snapshot = stages();
+
+    os << "{\"peak_rss_kb\": " << _details::peak_rss_kb() << ", \"stages\": [";
+    for (std::size_t i = 0; i != snapshot.size(); ++i) {
+      const stage_stats& st = snapshot[i];
+      double avg = st.tasks ? st.task_total_ms / static_cast<double>(st.tasks) : 0;
+      os << (i ? ", " : "") << "{\"name\": \"" << st.name << "\", \"wall_ms\": " << st.wall_ms
+         << ", \"cpu_ms\": " << st.cpu_ms << ", \"records_in\": " << st.records_in
+         << ", \"records_out\": " << st.records_out << ", \"bytes_out\": " << st.bytes_out
+         << ", \"tasks\": " << st.tasks << ", \"task_min_ms\": " << st.task_min_ms
+         << ", \"task_max_ms\": " << st.task_max_ms << ", \"task_avg_ms\": " << avg
+         << ", \"process_peak_rss_kb\": " << st.process_peak_rss_kb
+         << ", \"mem_peak_bytes\": " << st.mem_peak_bytes;
+      if (!st.nodes.empty()) {
+        os << ", \"nodes\": [";
+        for (std::size_t n = 0; n != st.nodes.size(); ++n) {
+          const node_stats& ns = st.nodes[n];
+          double rate = ns.task_total_ms > 0 ? static_cast<double>(ns.records_in) * 1e3 /
+                                                   ns.task_total_ms
+                                             : 0;
+          os << (n ? ", " : "") << "{\"node\": " << n << ", \"tasks\": " << ns.tasks
+             << ", \"records_in\": " << ns.records_in << ", \"task_total_ms\": "
+             << ns.task_total_ms << ", \"records_per_s\": " << rate << "}";
+        }
+        os << "]";
+      }
+      os << "}";
+    }
+    os << "]}";
+  }
+};
+
+/**
+ * @brief Class "Stage Timer".
+ * @details Measures the time of a scope and adds it to the stage on destruction,
+ * either as a run of the whole stage or as one of its tasks. The CPU time of
+ * the timers nested on the same thread is taken out of the enclosing one, so
+ * it is counted once.
+ */
+class stage_timer {
+public:
+  enum class kind { stage, task };
+
+private:
+  using clock_t = std::chrono::steady_clock;
+
+  job_stats& stats_;
+  stage_stats& stage_;
+  kind kind_;
+  clock_t::time_point start_;
+  double cpu_start_;
+  /** @brief Nested CPU time of the enclosing timer before this one. */
+  double outer_nested_;
+
+public:
+  /**
+   * @brief Constructor with param.
+   * @param [in] stats - statistics of the job.
+   * @param [in] stage - stage to add the time to.
+   * @param [in] what - is the scope the whole stage or one task of it.
+   */
+  stage_timer(job_stats& stats, stage_stats& stage, kind what = kind::stage)
+    : stats_(stats),
+      stage_(stage),
+      kind_(what),
+      start_(clock_t::now()),
+      cpu_start_(_details::thread_cpu_ms()),
+      outer_nested_(_details::nested_cpu_ms()) {
+    _details::nested_cpu_ms() = 0;
+  }
+
+  stage_timer(const stage_timer&) = delete;
+  stage_timer& operator=(const stage_timer&) = delete;
+
+  ~stage_timer() {
+    std::chrono::duration<double, std::milli> wall = clock_t::now() - start_;
+    double cpu = _details::thread_cpu_ms() - cpu_start_;
+    double own = cpu - _details::nested_cpu_ms();
+    _details::nested_cpu_ms() = outer_nested_ + cpu;
+    if (kind_ == kind::stage)
+      stats_.add_run(stage_, wall.count(), own);
+    else
+      stats_.add_task(stage_, wall.count(), own);
+  }
+};
+
+} /* core:: */
+} /* yamr:: */
+
+#endif /* CORE_STATS_HPP_ */
@@ -0,0 +1,424 @@
+/**
+ * @file thread_pool.hpp
+ * @brief Definition of the class "Thread Pool".
+ *
+ * @author Maxim <john.jasper.doe@gmail.com>
+ * @date 2020
+ */
+
+#ifndef CORE_THREAD_POOL_HPP_
+#define CORE_THREAD_POOL_HPP_
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "job_control.hpp"
+#include "numa.hpp"
+
+/** @brief The namespace of the MAP REDUCE project */
+namespace yamr {
+/** @brief The namespace of the Core */
+namespace core {
+
+/**
+ * @brief The work-stealing thread pool.
+ *
+ * @details
+ * Every worker owns a task queue, tasks submitted from a worker go to its own
+ * queue. A worker takes the newest task of its own queue and, when it is
+ * empty, steals the oldest task of another worker. The workers live as long
+ * as the pool, so the pool can be shared by any number of jobs.
+ *
+ * Tasks submitted from the outside belong to the group of the submitting
+ * thread (see "group_scope"), every group has its own queue. Idle workers
+ * serve the group queues round-robin, one task at a time, so the jobs that
+ * share the pool get their tasks started fairly, whatever the number of
+ * tasks every job submits.
+ *
+ * Workers may be placed on the NUMA nodes (see "placement"): worker "i" runs
+ * on node "i % nodes()". A task submitted with a slot prefers the workers of
+ * node "slot % nodes()", so the data that the task allocates first stays on
+ * that node, and the tasks of the next stage with the same slot find it
+ * there. The preference is not binding, an idle worker of another node takes
+ * the task rather than waiting.
+ *
+ * A task runs under the job control of the submitting thread (see
+ * "control_scope"), so the loops of the nested tasks of a job stop with it.
+ */
+class thread_pool {
+  /** @brief Move-only type-erased task. */
+  class task {
+    struct base {
+      virtual ~base() = default;
+      virtual void call() = 0;
+    };
+
+    template <class F>
+    struct impl : base {
+      F func_;
+      explicit impl(F&& func) : func_(std::move(func)) {}
+      void call() override {
+        func_();
+      }
+    };
+
+    std::unique_ptr<base> impl_;
+
+  public:
+    task() = default;
+
+    template <class F>
+    explicit task(F&& func) : impl_(new impl<std::decay_t<F>>(std::forward<F>(func))) {}
+
+    void operator()() {
+      impl_->call();
+    }
+  };
+
+  /** @brief Task queue of the worker. */
+  struct worker_queue {
+    std::mutex mtx;
+    std::deque<task> tasks;
+  };
+
+  /** @brief Task submitted from the outside with its preferred node. */
+  struct placed_task {
+    std::size_t node;
+    task func;
+  };
+
+  /** @brief Queue of the tasks submitted from the outside by one group. */
+  struct group_queue {
+    std::size_t group;
+    std::deque<placed_task> tasks;
+  };
+
+  std::vector<std::unique_ptr<worker_queue>> queues_;
+  std::vector<std::thread> threads_;
+  /** @brief Node of every worker. */
+  std::vector<std::size_t> worker_node_;
+  std::size_t nodes_{1};
+
+  std::mutex mtx_;
+  std::condition_variable cv_;
+  /** @brief Number of submitted tasks not taken by any worker yet. */
+  std::size_t pending_{0};
+  bool stop_{false};
+  /** @brief Groups with outside tasks, the front one is served next. */
+  std::deque<group_queue> groups_;
+
+  /** @brief Last group id given out. */
+  static std::atomic<std::size_t> last_group_;
+  /** @brief Group of the tasks submitted by the current thread. */
+  static thread_local std::size_t current_group_;
+
+  /** @brief Pool of the current thread, if it is a worker. */
+  static thread_local thread_pool* current_pool_;
+  /** @brief Index of the current worker. */
+  static thread_local std::size_t current_idx_;
+
+public:
+  /** @brief Placement of the workers on the CPUs. */
+  enum class placement {
+    /** @brief Workers run anywhere, the pool is one node. */
+    none,
+    /** @brief Every worker is pinned to its own CPU, the CPUs are taken from the nodes in turn. */
+    core,
+    /** @brief Every worker is pinned to all CPUs of its node. */
+    node
+  };
+
+  /** @brief Slot of the tasks without a preferred node. */
+  static constexpr std::size_t any_slot = static_cast<std::size_t>(-1);
+
+  /**
+   * @brief Class "Group Scope".
+   * @details Tasks submitted from the outside by the current thread belong to
+   * the group while the object lives.
+   */
+  class group_scope {
+    std::size_t prev_;
+
+  public:
+    explicit group_scope(std::size_t group) noexcept : prev_(current_group_) {
+      current_group_ = group;
+    }
+
+    group_scope(const group_scope&) = delete;
+    group_scope& operator=(const group_scope&) = delete;
+
+    ~group_scope() {
+      current_group_ = prev_;
+    }
+  };
+
+  /**
+   * @brief Get a new group id.
+   * @return Group id, unique in the process.
+   */
+  static std::size_t make_group() noexcept {
+    return ++last_group_;
+  }
+
+  /**
+   * @brief Constructor with param.
+   * @param [in] threads - number of workers, the hardware concurrency if zero.
+   * @param [in] pin - pin every worker to its own CPU core.
+   */
+  explicit thread_pool(std::size_t threads = 0, bool pin = false)
+    : thread_pool(threads, pin ? placement::core : placement::none) {}
+
+  /**
+   * @brief Constructor with param.
+   * @param [in] threads - number of workers, the number of allowed CPUs if zero.
+   * @param [in] where - placement of the workers, the NUMA topology is read
+   * from the sysfs unless it is "none".
+   */
+  thread_pool(std::size_t threads, placement where) {
+    numa_topology topo = where == placement::none ? numa_topology{} : numa_topology::detect();
+    if (where != placement::none)
+      nodes_ = topo.size();
+    if (threads == 0)
+      threads = where == placement::none ? std::max(1u, std::thread::hardware_concurrency())
+                                         : _details::allowed_cpus().size();
+
+    for (std::size_t i = 0; i != threads; ++i) {
+      queues_.push_back(std::make_unique<worker_queue>());
+      worker_node_.push_back(i % nodes_);
+    }
+
+    for (std::size_t i = 0; i != threads; ++i) {
+      threads_.emplace_back([this, i] { loop(i); });
+      if (where == placement::none)
+        continue;
+
+      const std::vector<std::size_t>& node_cpus = topo.cpus(worker_node_[i]);
+      cpu_set_t cpus;
+      CPU_ZERO(&cpus);
+      if (where == placement::core)
+        CPU_SET(node_cpus[(i / nodes_) % node_cpus.size()], &cpus);
+      else {
+        for (std::size_t cpu : node_cpus)
+          CPU_SET(cpu, &cpus);
+      }
+      pthread_setaffinity_np(threads_.back().native_handle(), sizeof(cpus), &cpus);
+    }
+  }
+
+  thread_pool(const thread_pool&) = delete;
+  thread_pool& operator=(const thread_pool&) = delete;
+
+  /** @brief Destructor, waits until all submitted tasks are done. */
+  ~thread_pool() {
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      stop_ = true;
+    }
+    cv_.notify_all();
+    for (std::thread& t : threads_)
+      t.join();
+  }
+
+  /**
+   * @brief Get number of workers.
+   * @return Number of workers.
+   */
+  std::size_t size() const noexcept {
+    return threads_.size();
+  }
+
+  /**
+   * @brief Get number of NUMA nodes the workers are placed on.
+   * @return Number of nodes, one if the workers are not placed.
+   */
+  std::size_t nodes() const noexcept {
+    return nodes_;
+  }
+
+  /**
+   * @brief Get the node of the current worker.
+   * @return Node of the worker, zero if the thread is not a worker.
+   */
+  static std::size_t current_node() noexcept {
+    return current_pool_ ? current_pool_->worker_node_[current_idx_] : 0;
+  }
+
+  /**
+   * @brief Schedule a task.
+   * @param [in] func - callable without arguments.
+   * @param [in] slot - index of the task in its stage, the task prefers the
+   * workers of node "slot % nodes()"; ignored for the tasks submitted by a
+   * worker, they go to its own queue.
+   * @return Future of the callable result.
+   */
+  template <class F>
+  std::future<std::invoke_result_t<std::decay_t<F>>> submit(F&& func,
+                                                            std::size_t slot = any_slot) {
+    using result_t = std::invoke_result_t<std::decay_t<F>>;
+
+    std::packaged_task<result_t()> ptask(
+        [control = _details::task_control(), func = std::forward<F>(func)]() mutable {
+          control_scope scope(control);
+          return func();
+        });
+    std::future<result_t> res = ptask.get_future();
+
+    if (current_pool_ == this) {
+      {
+        std::lock_guard<std::mutex> lock(mtx_);
+        ++pending_;
+      }
+      std::lock_guard<std::mutex> lock(queues_[current_idx_]->mtx);
+      queues_[current_idx_]->tasks.emplace_back(std::move(ptask));
+    }
+    else {
+      std::lock_guard<std::mutex> lock(mtx_);
+      ++pending_;
+      auto it = std::find_if(groups_.begin(), groups_.end(),
+                             [](const group_queue& q) { return q.group == current_group_; });
+      if (it == groups_.end())
+        it = groups_.insert(groups_.end(), group_queue{current_group_, {}});
+      std::size_t node = slot == any_slot ? any_slot : slot % nodes_;
+      it->tasks.push_back(placed_task{node, task(std::move(ptask))});
+    }
+    cv_.notify_one();
+
+    return res;
+  }
+
+  /**
+   * @brief Run one pending task on the calling worker.
+   * @details Lets a worker that waits for other tasks help instead of blocking.
+   * @return "True" - a task was run, "False" - nothing is pending or the
+   * calling thread is not a worker of the pool.
+   */
+  bool run_pending_task() {
+    if (current_pool_ != this)
+      return false;
+    task t;
+    if (!take(current_idx_, t))
+      return false;
+    t();
+    return true;
+  }
+
+  /**
+   * @brief Wait until the result of a task is ready.
+   * @details A worker of the pool runs the pending tasks meanwhile, so a task
+   * that waits for the tasks it submitted does not hold its worker, even on a
+   * pool of one worker. Other threads simply block.
+   * @param [in] fut - future of the task.
+   */
+  template <class T>
+  void wait(const std::future<T>& fut) {
+    if (current_pool_ != this) {
+      fut.wait();
+      return;
+    }
+    while (fut.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+      if (!run_pending_task())
+        fut.wait_for(std::chrono::milliseconds(1));
+    }
+  }
+
+private:
+  bool take(std::size_t idx, task& t) {
+    /* own queue first, the newest task is the warmest one */
+    {
+      worker_queue& own = *queues_[idx];
+      std::lock_guard<std::mutex> lock(own.mtx);
+      if (!own.tasks.empty()) {
+        t = std::move(own.tasks.back());
+        own.tasks.pop_back();
+        taken();
+        return true;
+      }
+    }
+
+    /* the oldest task of the next group, the ones placed on the node of the worker first */
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      if (!groups_.empty()) {
+        group_queue& front = groups_.front();
+        std::size_t node = worker_node_[idx];
+        auto local = [node](const placed_task& p) { return p.node == node || p.node == any_slot; };
+        auto it = std::find_if(front.tasks.begin(), front.tasks.end(), local);
+        if (it == front.tasks.end())
+          it = front.tasks.begin();
+        t = std::move(it->func);
+        front.tasks.erase(it);
+        if (front.tasks.empty())
+          groups_.pop_front();
+        else if (groups_.size() > 1) {
+          groups_.push_back(std::move(front));
+          groups_.pop_front();
+        }
+        --pending_;
+        return true;
+      }
+    }
+
+    /* steal the oldest task of another worker, of the same node first */
+    for (bool local : {true, false}) {
+      for (std::size_t i = 1; i != queues_.size(); ++i) {
+        std::size_t other = (idx + i) % queues_.size();
+        if ((worker_node_[other] == worker_node_[idx]) != local)
+          continue;
+        worker_queue& victim = *queues_[other];
+        std::lock_guard<std::mutex> lock(victim.mtx);
+        if (!victim.tasks.empty()) {
+          t = std::move(victim.tasks.front());
+          victim.tasks.pop_front();
+          taken();
+          return true;
+        }
+      }
+    }
+    return false;
+  }
+
+  void taken() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    --pending_;
+  }
+
+  void loop(std::size_t idx) {
+    current_pool_ = this;
+    current_idx_ = idx;
+
+    while (true) {
+      task t;
+      if (take(idx, t)) {
+        t();
+        continue;
+      }
+
+      std::unique_lock<std::mutex> lock(mtx_);
+      cv_.wait(lock, [this] { return stop_ || pending_ != 0; });
+      if (stop_ && pending_ == 0)
+        return;
+    }
+  }
+};
+
+inline thread_local thread_pool* thread_pool::current_pool_ = nullptr;
+inline thread_local std::size_t thread_pool::current_idx_ = 0;
+inline std::atomic<std::size_t> thread_pool::last_group_{0};
+inline thread_local std::size_t thread_pool::current_group_ = 0;
+
+} /* core:: */
+} /* yamr:: */
+
+#endif /* CORE_THREAD_POOL_HPP_ */
@@ -0,0 +1,128 @@
+/**
+ * @file trie_job.hpp
+ * @brief Map and reduce functions of the prefix trie job.
+ *
+ * @author Maxim <john.jasper.doe@gmail.com>
+ * @date 2020
+ */
+
+#ifndef CORE_TRIE_JOB_HPP_
+#define CORE_TRIE_JOB_HPP_
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "job_control.hpp"
+
+#include "../common/prefix_trie.hpp"
+
+/** @brief The namespace of the MAP REDUCE project */
+namespace yamr {
+/** @brief The namespace of the Core */
+namespace core {
+
+/**
+ * @brief The mapper of the trie job.
+ *
+ * @details
+ * Unlike "mapper_func" no prefix is emitted. The lines of the split are put
+ * into tries, one trie per first byte, so the output size depends on the
+ * number of distinct prefixes instead of the total length of the lines.
+ *
+ * @tparam DATA_TYPE - Input data type, "std::string" or "std::string_view".
+ */
+template <class DATA_TYPE>
+std::vector<common::prefix_trie> trie_mapper_func(std::vector<DATA_TYPE>&& lines) {
+  std::array<std::unique_ptr<common::prefix_trie>, 256> tries;
+
+  for (const DATA_TYPE& s : lines) {
+    check_stop();
+    if (s.empty())
+      continue;
+
+    auto key = static_cast<unsigned char>(s[0]);
+    if (!tries[key])
+      tries[key] = std::make_unique<common::prefix_trie>(key);
+    tries[key]->insert(s);
+  }
+
+  std::vector<common::prefix_trie> res;
+  for (std::unique_ptr<common::prefix_trie>& trie : tries) {
+    if (trie)
+      res.push_back(std::move(*trie));
+  }
+  return res;
+}
+
+/**
+ * @brief The combiner of the trie job.
+ * @details Tries with the same key are merged into one, so at most one trie
+ * per first byte leaves the map task. The output is sorted.
+ */
+inline std::vector<common::prefix_trie> trie_combiner_func(
+    std::vector<common::prefix_trie>&& tries) {
+  std::sort(tries.begin(), tries.end());
+
+  std::vector<common::prefix_trie> res;
+  for (common::prefix_trie& trie : tries) {
+    if (!res.empty() && res.back() == trie)
+      res.back().merge(trie);
+    else
+      res.push_back(std::move(trie));
+  }
+  return res;
+}
+
+/**
+ * @brief The reducer of the trie job.
+ *
+ * @details
+ * Tries with the same key are merged, the result is the deepest node shared
+ * by more than one line, the same value "reducer_func" finds for the prefixes
+ * of "mapper_func".
+ *
+ * @tparam OUT_TYPE - Output data type, a "common::counter" of a string.
+ */
+template <class OUT_TYPE>
+OUT_TYPE trie_reducer_func(std::vector<common::prefix_trie>&& tries) {
+  using key_t = typename OUT_TYPE::value_type;
+
+  std::array<std::unique_ptr<common::prefix_trie>, 256> merged;
+  for (common::prefix_trie& trie : tries) {
+    std::unique_ptr<common::prefix_trie>& dst = merged[trie.key()];
+    if (!dst)
+      dst = std::make_unique<common::prefix_trie>(std::move(trie));
+    else
+      dst->merge(trie);
+  }
+
+  std::string best;
+  std::uint64_t best_count = 0;
+  for (std::unique_ptr<common::prefix_trie>& trie : merged) {
+    if (!trie)
+      continue;
+
+    auto [prefix, count] = trie->deepest_shared();
+    bool shared = count > 1;
+    bool best_shared = best_count > 1;
+    if (best_count == 0 || (shared && !best_shared) ||
+        (shared == best_shared && prefix.size() > best.size())) {
+      best = std::move(prefix);
+      best_count = count;
+    }
+  }
+
+  OUT_TYPE res(key_t(std::move(best)));
+  if (best_count > 1)
+    res.add_count(best_count - 1);
+  return res;
+}
+
+} /* core:: */
+} /* yamr:: */
+
+#endif /* CORE_TRIE_JOB_HPP_ */
@@ -8,14 +8,20 @@
 
 /* See the license in the file "LICENSE.txt" in the root directory. */
 
+#include <chrono>
 #include <fstream>
 #include <iostream>
+#include <memory>
+#include <string_view>
 
 #include "boost/program_options.hpp"
 
+#include "core/approx_job.hpp"
 #include "core/mapreduce.hpp"
+#include "core/trie_job.hpp"
 
 #include "common/counter.hpp"
+#include "common/mapped_file.hpp"
 
 namespace {
 
@@ -23,6 +29,22 @@ struct param {
   std::string src{""};
   std::size_t mnum{0};
   std::size_t rnum{0};
+  std::string engine{"substr"};
+  yamr::core::shuffle_mode shuffle{yamr::core::shuffle_mode::sort_merge};
+  bool combine{false};
+  std::size_t spill_budget{0};
+  std::string spill_dir{"/tmp"};
+  bool stream{false};
+  std::size_t chunk{0};
+  std::string stats{""};
+  std::size_t procs{0};
+  std::string state{""};
+  std::size_t timeout{0};
+  std::size_t sketch{1024};
+  std::size_t sketch_len{64};
+  yamr::core::thread_pool::placement numa{yamr::core::thread_pool::placement::none};
+  std::size_t mem_limit{0};
+  std::string checkpoint{""};
 };
 
 using param_t = param;
@@ -38,7 +60,43 @@ void get_param(const int argc, const char* const argv[], param_t& param) {
       ("mnum,m", po::value<std::size_t>()->default_value(3),
        "number of threads to work with map function (def: 3)")
       ("rnum,r", po::value<std::size_t>()->default_value(3),
-       "number of threads to work with reduce function (def: 3)");
+       "number of threads to work with reduce function (def: 3)")
+      ("engine,e", po::value<std::string>()->default_value("substr"),
+       "job engine: \"trie\", the reference \"substr\" or the fixed-memory estimate "
+       "\"approx\" (def: substr)")
+      ("shuffle", po::value<std::string>()->default_value("sort"),
+       "shuffle mode: \"sort\" - global sort-merge, \"hash\" - hash partitions (def: sort)")
+      ("combine", "fold duplicate prefixes (\"substr\") or tries (\"trie\") in the map tasks")
+      ("spill-budget", po::value<std::size_t>()->default_value(0),
+       "MiB of map output kept in memory, the rest is spilled to disk (def: 0 - no limit)")
+      ("spill-dir", po::value<std::string>()->default_value("/tmp"),
+       "directory for spilled run files (def: /tmp)")
+      ("stream", "pipeline the read, map, shuffle and reduce stages over input chunks")
+      ("chunk", po::value<std::size_t>()->default_value(1024),
+       "KiB of input per chunk in the stream mode (def: 1024)")
+      ("stats", po::value<std::string>()->default_value(""),
+       "write the statistics of the job stages as JSON to the file, \"-\" - to stdout")
+      ("procs", po::value<std::size_t>()->default_value(0),
+       "run the tasks on worker processes, the intermediate files go to --spill-dir "
+       "(def: 0 - threads)")
+      ("state", po::value<std::string>()->default_value(""),
+       "state file of the incremental mode: the input is added to the state of the previous "
+       "runs, the result is for all inputs so far")
+      ("timeout", po::value<std::size_t>()->default_value(0),
+       "stop the job after the given milliseconds (def: 0 - no limit)")
+      ("sketch", po::value<std::size_t>()->default_value(1024),
+       "counters per prefix length of the \"approx\" engine (def: 1024)")
+      ("sketch-len", po::value<std::size_t>()->default_value(64),
+       "longest prefix tracked by the \"approx\" engine (def: 64)")
+      ("numa", po::value<std::string>()->default_value("none"),
+       "placement of the workers: \"none\", \"core\" - pinned to a CPU, \"node\" - pinned to "
+       "a NUMA node; tasks and their data are kept on the nodes (def: none)")
+      ("mem-limit", po::value<std::size_t>()->default_value(0),
+       "MiB of records the job may hold, the sort shuffle spills to --spill-dir to stay "
+       "within, otherwise the job fails (def: 0 - no limit)")
+      ("checkpoint", po::value<std::string>()->default_value(""),
+       "work directory for the map output, a job run again after a failure maps only the "
+       "input it has not mapped yet");
   // clang-format on
 
   po::variables_map vm;
@@ -75,18 +133,126 @@ void get_param(const int argc, const char* const argv[], param_t& param) {
     param.rnum = vm["r"].as<std::size_t>();
   else
     throw std::invalid_argument("Number of threads for reduce was not set");
+
+  param.engine = vm["engine"].as<std::string>();
+  if (param.engine != "trie" && param.engine != "substr" && param.engine != "approx")
+    throw std::invalid_argument("Unknown engine " + param.engine);
+
+  std::string shuffle = vm["shuffle"].as<std::string>();
+  if (shuffle == "hash")
+    param.shuffle = yamr::core::shuffle_mode::hash;
+  else if (shuffle != "sort")
+    throw std::invalid_argument("Unknown shuffle mode " + shuffle);
+
+  param.combine = vm.count("combine") != 0;
+  param.spill_budget = vm["spill-budget"].as<std::size_t>() << 20;
+  param.spill_dir = vm["spill-dir"].as<std::string>();
+  param.stream = vm.count("stream") != 0;
+  param.chunk = vm["chunk"].as<std::size_t>() << 10;
+  param.stats = vm["stats"].as<std::string>();
+  param.procs = vm["procs"].as<std::size_t>();
+  if (param.procs != 0 && param.stream)
+    throw std::invalid_argument("Worker processes do not support the stream mode");
+  param.state = vm["state"].as<std::string>();
+  if (!param.state.empty() && (param.stream || param.procs != 0))
+    throw std::invalid_argument("The incremental mode supports neither streams nor processes");
+  param.sketch = vm["sketch"].as<std::size_t>();
+  param.sketch_len = vm["sketch-len"].as<std::size_t>();
+  std::string numa = vm["numa"].as<std::string>();
+  if (numa == "core")
+    param.numa = yamr::core::thread_pool::placement::core;
+  else if (numa == "node")
+    param.numa = yamr::core::thread_pool::placement::node;
+  else if (numa != "none")
+    throw std::invalid_argument("Unknown placement " + numa);
+  param.mem_limit = vm["mem-limit"].as<std::size_t>() << 20;
+  if (param.mem_limit != 0 && (param.stream || param.procs != 0))
+    throw std::invalid_argument("The memory limit supports neither streams nor processes");
+  param.checkpoint = vm["checkpoint"].as<std::string>();
+  if (!param.checkpoint.empty() && (param.stream || param.procs != 0 || !param.state.empty() ||
+                                    param.spill_budget != 0 || param.mem_limit != 0))
+    throw std::invalid_argument(
+        "The checkpoint supports neither streams, processes, states nor spilling");
+  param.timeout = vm["timeout"].as<std::size_t>();
+  if (param.timeout != 0 && (param.stream || param.procs != 0 || !param.state.empty()))
+    throw std::invalid_argument("The timeout supports neither streams, processes nor states");
+  /* the state keeps one counter per prefix or one trie per first byte */
+  if (!param.state.empty())
+    param.combine = true;
 }
 
-std::vector<std::string> read_file(std::fstream& strm) {
-  std::vector<std::string> lines;
+/**
+ * @brief Run the job on the mapped input.
+ * @details Records are views into the mapping, it must outlive the job.
+ * @param [in] mr - map reduce object.
+ * @param [in] prm - params.
+ * @param [in] buf - mapped input.
+ * @param [in] funcs - map, combine, reduce and final functions.
+ * @return Result of the job.
+ */
+template <class MR, class... F>
+auto run_job(MR& mr, const param_t& prm, std::string_view buf, F&&... funcs) {
+  if (prm.stream) {
+    common::record_reader reader(buf, prm.chunk);
+    return mr.run_stream([&reader] { return reader.next(); }, std::forward<F>(funcs)...);
+  }
+
+  std::vector<std::vector<std::string_view>> splitted;
+  {
+    yamr::core::job_stats& stats = mr.stats();
+    yamr::core::stage_timer timer(stats, stats.stage("split"));
+    splitted = common::split_records(buf, prm.mnum);
+
+    std::size_t records = 0;
+    for (const std::vector<std::string_view>& part : splitted)
+      records += part.size();
+    stats.add_records(stats.stage("split"), records, records, buf.size());
+  }
+
+  if (prm.timeout != 0) {
+    std::chrono::milliseconds timeout(prm.timeout);
+    return mr.run_async(std::move(splitted), std::forward<F>(funcs)..., timeout).get();
+  }
+  if (!prm.state.empty())
+    return mr.run_incremental(std::move(splitted), std::forward<F>(funcs)..., prm.state);
+  if (prm.procs != 0) {
+    mr.set_processes(prm.procs, prm.spill_dir);
+    return mr.run_processes(std::move(splitted), std::forward<F>(funcs)...);
+  }
+  return mr.run(std::move(splitted), std::forward<F>(funcs)...);
+}
+
+/**
+ * @brief Write the statistics of the job.
+ * @param [in] stats - statistics.
+ * @param [in] path - path to the file, "-" - stdout, empty - nothing is written.
+ */
+void write_stats(const yamr::core::job_stats& stats, const std::string& path) {
+  if (path.empty())
+    return;
 
-  while (strm) {
-    std::string tmp;
-    strm >> tmp;
-    if (!tmp.empty())
-      lines.push_back(std::move(tmp));
+  if (path == "-") {
+    stats.write_json(std::cout);
+    std::cout << std::endl;
+    return;
   }
-  return lines;
+
+  std::ofstream os(path);
+  stats.write_json(os);
+  os << std::endl;
+  if (!os)
+    std::cerr << "Can not write statistics to " << path << std::endl;
+}
+
+/**
+ * @brief Get the minimal identifying prefix size.
+ * @param [in] res - the longest prefix shared by more than one line.
+ * @return Size of the prefix, exact.
+ */
+template <class T>
+common::prefix_estimate prefix_size(const T& res) {
+  std::size_t size = (res.count() > 1 ? res.strlen() : 0) + 1;
+  return common::prefix_estimate{size, size, size};
 }
 
 } /* :: */
@@ -106,22 +272,81 @@ int main(int argc, const char* argv[]) {
     return EXIT_FAILURE;
   }
 
-  std::fstream fstrm(prm.src);
-  if (!fstrm) {
+  std::unique_ptr<common::mapped_file> src;
+  try {
+    src = std::make_unique<common::mapped_file>(prm.src);
+  }
+  catch (const std::system_error&) {
     std::cerr << "Can not opened file" << std::endl;
     return EXIT_SUCCESS;
   }
-  std::vector<std::string> lines = read_file(fstrm);
-  fstrm.close();
 
-  auto map_reduc =
-      map_reduce<std::string, str_counter_t, str_counter_t, str_counter_t>(prm.mnum, prm.rnum);
+  /* the result of the substr job views the input or the arenas of the job */
+  auto job = [&]() {
+    if (prm.engine == "approx") {
+      using common::prefix_sketch;
+      auto map_reduc = map_reduce<std::string_view, prefix_sketch, prefix_sketch, prefix_sketch>(
+          prm.mnum, prm.rnum, prm.numa);
+      map_reduc.set_shuffle(prm.shuffle);
+      map_reduc.set_spill(prm.spill_budget, prm.spill_dir);
+      map_reduc.set_memory_limit(prm.mem_limit);
+      map_reduc.set_checkpoint(prm.checkpoint);
+      approx_map mfunc{prm.sketch_len, prm.sketch};
+      prefix_sketch res = run_job(map_reduc, prm, src->view(), mfunc, nullptr, approx_reducer_func,
+                                  approx_reducer_func);
+      write_stats(map_reduc.stats(), prm.stats);
+      return res.estimate();
+    }
 
-  str_counter_t res = map_reduc.run(std::move(lines), mapper_func<str_counter_t>,
-                                    reducer_func<str_counter_t>, reducer_func<str_counter_t>);
+    if (prm.engine == "substr") {
+      using view_counter_t = common::counter<std::string_view>;
+      auto map_reduc = map_reduce<std::string_view, view_counter_t, view_counter_t, view_counter_t>(
+          prm.mnum, prm.rnum, prm.numa);
+      map_reduc.set_shuffle(prm.shuffle);
+      map_reduc.set_spill(prm.spill_budget, prm.spill_dir);
+      map_reduc.set_memory_limit(prm.mem_limit);
+      map_reduc.set_checkpoint(prm.checkpoint);
+      cfunc_ptr_t<view_counter_t> cfunc;
+      if (prm.combine)
+        cfunc = combiner_func<view_counter_t>;
+      auto mfunc = map_each<view_counter_t>(prefix_map<view_counter_t>{});
+      /* the reduce tasks get merged, sorted data; the final function does not */
+      view_counter_t res =
+          run_job(map_reduc, prm, src->view(), mfunc, cfunc, sorted_reducer_func<view_counter_t>,
+                  reducer_func<view_counter_t>);
+      write_stats(map_reduc.stats(), prm.stats);
+      return prefix_size(res);
+    }
+
+    auto map_reduc =
+        map_reduce<std::string_view, common::prefix_trie, str_counter_t, str_counter_t>(
+            prm.mnum, prm.rnum, prm.numa);
+    map_reduc.set_shuffle(prm.shuffle);
+    map_reduc.set_spill(prm.spill_budget, prm.spill_dir);
+    map_reduc.set_memory_limit(prm.mem_limit);
+    map_reduc.set_checkpoint(prm.checkpoint);
+    cfunc_ptr_t<common::prefix_trie> cfunc;
+    if (prm.combine)
+      cfunc = trie_combiner_func;
+    str_counter_t res =
+        run_job(map_reduc, prm, src->view(), trie_mapper_func<std::string_view>, cfunc,
+                trie_reducer_func<str_counter_t>, reducer_func<str_counter_t>);
+    write_stats(map_reduc.stats(), prm.stats);
+    return prefix_size(res);
+  };
+
+  common::prefix_estimate size{};
+  try {
+    size = job();
+  }
+  catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
 
-  std::cout << "Minimal identifying prefix size: " << (res.count() > 1 ? res.strlen() : 0) + 1
-            << std::endl;
+  std::cout << "Minimal identifying prefix size: " << size.size << std::endl;
+  if (prm.engine == "approx")
+    std::cout << "Exact size is in [" << size.lower << ", " << size.upper << "]" << std::endl;
 
   return EXIT_SUCCESS;
 }
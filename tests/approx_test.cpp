@@ -0,0 +1,128 @@
+/**
+ * @file approx_test.cpp
+ * @brief Tests of the approximate prefix job and of its sketches.
+ *
+ * @author Maxim <john.jasper.doe@gmail.com>
+ * @date 2020
+ */
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "tests/corpus.hpp"
+#include "tests/test.hpp"
+
+#include "core/approx_job.hpp"
+#include "core/mapreduce.hpp"
+
+#include "common/arena.hpp"
+#include "common/prefix_sketch.hpp"
+#include "common/serializer.hpp"
+#include "common/split.hpp"
+
+namespace {
+
+using common::prefix_sketch;
+using sketch_serializer = common::serializer<prefix_sketch>;
+
+using tests::expected_size;
+using tests::make_input;
+
+/** @brief Run the approximate job. */
+common::prefix_estimate approx_job(std::string_view buf, std::size_t capacity,
+                                   yamr::core::shuffle_mode shuffle, std::size_t spill_budget) {
+  using namespace yamr::core;
+  map_reduce<std::string_view, prefix_sketch, prefix_sketch, prefix_sketch> mr(3, 2);
+  mr.set_shuffle(shuffle);
+  mr.set_spill(spill_budget, std::filesystem::temp_directory_path().string());
+  prefix_sketch res = mr.run(common::split_records(buf, 3), approx_map{64, capacity}, nullptr,
+                             approx_reducer_func, approx_reducer_func);
+  return res.estimate();
+}
+
+void test_estimate() {
+  using yamr::core::shuffle_mode;
+  for (unsigned seed = 1; seed != 4; ++seed) {
+    const std::string input = make_input(300, seed);
+    const std::size_t exact = expected_size(input);
+
+    /* the sketches of the sort, hash and spilling shuffles */
+    for (shuffle_mode shuffle : {shuffle_mode::sort_merge, shuffle_mode::hash}) {
+      for (std::size_t budget : {std::size_t{0}, std::size_t{1}}) {
+        if (shuffle == shuffle_mode::hash && budget != 0)
+          continue;
+
+        /* a counter per prefix, the estimate is exact */
+        common::prefix_estimate res = approx_job(input, 4096, shuffle, budget);
+        CHECK(res.size == exact && res.lower == exact && res.upper == exact);
+
+        /* a few counters, the exact answer is within the bounds */
+        res = approx_job(input, 4, shuffle, budget);
+        CHECK(res.lower <= exact && exact <= res.upper);
+      }
+    }
+  }
+}
+
+void test_empty() {
+  prefix_sketch res = yamr::core::approx_reducer_func({});
+  CHECK(res.lengths().empty());
+  CHECK(res.estimate().size == 1);
+}
+
+std::string write(const prefix_sketch& obj) {
+  std::ostringstream os;
+  sketch_serializer::write(os, obj);
+  return os.str();
+}
+
+std::optional<prefix_sketch> read(const std::string& data) {
+  std::istringstream is(data);
+  common::string_arena arena;
+  return sketch_serializer::read(is, arena);
+}
+
+std::string u64(std::uint64_t val) {
+  return std::string(reinterpret_cast<const char*>(&val), sizeof(val));
+}
+
+void test_serializer() {
+  prefix_sketch src(4, 2);
+  for (const char* word : {"first", "fist", "fisddt", "fist", "fsdfist"})
+    src.insert(word);
+  const std::string data = write(src);
+
+  std::optional<prefix_sketch> res = read(data);
+  CHECK(res);
+  CHECK(res->longest() == src.longest());
+  CHECK(res->lengths().size() == src.lengths().size());
+  CHECK(res->estimate().size == src.estimate().size);
+  CHECK(!read(""));
+
+  for (std::size_t size = 1; size != data.size(); ++size)
+    CHECK_THROWS(read(data.substr(0, size)), std::runtime_error);
+
+  /* damaged sizes fail on the end of the stream instead of allocating */
+  CHECK_THROWS(read(u64(5) + u64(UINT64_MAX)), std::runtime_error);
+  CHECK_THROWS(read(u64(5) + u64(1) + u64(1) + u64(0) + u64(UINT64_MAX)), std::runtime_error);
+  CHECK_THROWS(read(u64(5) + u64(1) + u64(1) + u64(0) + u64(2)), std::runtime_error);
+
+  /* a damaged capacity is not reserved */
+  res = read(u64(5) + u64(1) + u64(UINT64_MAX / 2) + u64(0) + u64(0));
+  CHECK(res && res->lengths().front().capacity() == UINT64_MAX / 2);
+}
+
+} /* :: */
+
+int main() {
+  test_estimate();
+  test_empty();
+  test_serializer();
+  return EXIT_SUCCESS;
+}
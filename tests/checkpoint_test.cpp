@@ -0,0 +1,152 @@
+/**
+ * @file checkpoint_test.cpp
+ * @brief Tests of the map checkpoints of the "Map Reduce".
+ *
+ * @author Maxim <john.jasper.doe@gmail.com>
+ * @date 2020
+ */
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "tests/test.hpp"
+
+#include "core/mapper.hpp"
+#include "core/mapreduce.hpp"
+#include "core/reducer.hpp"
+
+#include "common/counter.hpp"
+#include "common/sort.hpp"
+#include "common/spill.hpp"
+
+namespace {
+
+using counter_t = common::counter<std::string_view>;
+using map_reduce_t = yamr::core::map_reduce<std::string_view, counter_t, counter_t, counter_t>;
+
+const std::size_t parts = 3;
+
+std::vector<std::string_view> lines() {
+  static const std::string text = [] {
+    std::string res;
+    for (std::size_t i = 0; i != 3000; ++i)
+      res += "user" + std::to_string(i) + "@otus.owl\n";
+    return res;
+  }();
+
+  std::vector<std::string_view> res;
+  for (std::size_t pos = 0; pos != text.size();) {
+    std::size_t end = text.find('\n', pos);
+    res.push_back(std::string_view(text).substr(pos, end - pos));
+    pos = end + 1;
+  }
+  return res;
+}
+
+/** @brief Work directory of the test, empty. */
+std::filesystem::path work_dir() {
+  std::filesystem::path res = std::filesystem::temp_directory_path() / "yamr-checkpoint-test";
+  std::filesystem::remove_all(res);
+  return res;
+}
+
+/**
+ * @brief Run the job.
+ * @param [in] dir - work directory, empty - no checkpoints.
+ * @param [in] fail - "True" - the reduce stage fails, the checkpoints are kept.
+ * @param [out] mapped - number of the input parts mapped.
+ * @return Result, empty if the job failed.
+ */
+counter_t run(const std::filesystem::path& dir, bool fail, std::size_t& mapped) {
+  std::atomic<std::size_t> count{0};
+  auto mfunc = [&count](std::vector<std::string_view>&& part) {
+    ++count;
+    return yamr::core::mapper_func<counter_t, std::string_view>(std::move(part));
+  };
+  auto rfunc = [fail](std::vector<counter_t>&& data) {
+    if (fail)
+      throw std::runtime_error("reduce failed");
+    return yamr::core::sorted_reducer_func<counter_t>(std::move(data));
+  };
+
+  map_reduce_t mr(parts, 2);
+  mr.set_checkpoint(dir.string());
+  counter_t res{std::string_view()};
+  if (fail)
+    CHECK_THROWS(mr.run(lines(), mfunc, rfunc, yamr::core::reducer_func<counter_t>),
+                 std::runtime_error);
+  else
+    res = mr.run(lines(), mfunc, rfunc, yamr::core::reducer_func<counter_t>);
+  mapped = count;
+  return res;
+}
+
+/** @brief Check that the job maps the parts and gets the result of a job without checkpoints. */
+void check_run(const std::filesystem::path& dir, std::size_t parts_mapped) {
+  std::size_t mapped = 0;
+  counter_t expected = run(std::filesystem::path(), false, mapped);
+  counter_t res = run(dir, false, mapped);
+  CHECK(mapped == parts_mapped);
+  CHECK(res.key() == expected.key() && res.count() == expected.count());
+}
+
+/** @brief Cut the bytes off the end of the first part of the map output. */
+void truncate_part(const std::filesystem::path& dir, std::uintmax_t cut) {
+  for (const std::filesystem::directory_entry& file : std::filesystem::directory_iterator(dir)) {
+    if (file.path().filename().string().compare(0, 4, "map-") == 0) {
+      std::filesystem::resize_file(file.path(), file.file_size() - cut);
+      return;
+    }
+  }
+  CHECK(!"no map output in the checkpoint");
+}
+
+void test_resume() {
+  std::filesystem::path dir = work_dir();
+  std::size_t mapped = 0;
+  run(dir, true, mapped);
+  CHECK(mapped == parts);
+  check_run(dir, 0);
+  std::filesystem::remove_all(dir);
+}
+
+void test_truncated_part() {
+  /* the end of the run only, all its records are whole; and the middle of a block */
+  for (std::uintmax_t cut : {6, 100}) {
+    std::filesystem::path dir = work_dir();
+    std::size_t mapped = 0;
+    run(dir, true, mapped);
+    truncate_part(dir, cut);
+    check_run(dir, 1);
+    std::filesystem::remove_all(dir);
+  }
+}
+
+void test_read_run_throws() {
+  std::filesystem::path path = work_dir();
+  std::vector<counter_t> data;
+  for (std::string_view line : lines())
+    data.emplace_back(std::string_view(line));
+  common::sort_records(data);
+  common::write_run(data, path.string());
+
+  common::string_arena arena;
+  CHECK(common::read_run<counter_t>(path.string(), arena).size() == data.size());
+  std::filesystem::resize_file(path, std::filesystem::file_size(path) - 6);
+  CHECK_THROWS(common::read_run<counter_t>(path.string(), arena), std::runtime_error);
+  std::filesystem::remove(path);
+}
+
+} /* :: */
+
+int main() {
+  test_resume();
+  test_truncated_part();
+  test_read_run_throws();
+  return EXIT_SUCCESS;
+}
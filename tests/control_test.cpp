@@ -0,0 +1,96 @@
+/**
+ * @file control_test.cpp
+ * @brief Tests of the cancellation and the time limit of the "Map Reduce" jobs.
+ *
+ * @author Maxim <john.jasper.doe@gmail.com>
+ * @date 2020
+ */
+
+#include <chrono>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "tests/test.hpp"
+
+#include "core/job_control.hpp"
+#include "core/mapper.hpp"
+#include "core/mapreduce.hpp"
+#include "core/reducer.hpp"
+
+#include "common/counter.hpp"
+
+namespace {
+
+using counter_t = common::counter<std::string_view>;
+using map_reduce_t = yamr::core::map_reduce<std::string_view, counter_t, counter_t, counter_t>;
+using steady_clock = std::chrono::steady_clock;
+
+/** @brief Input parts of "records" lines each. */
+std::vector<std::vector<std::string_view>> input(std::size_t parts, std::size_t records) {
+  return std::vector<std::vector<std::string_view>>(
+      parts, std::vector<std::string_view>(records, "first@otus.owl"));
+}
+
+/** @brief Per-record map function that takes at least 10 seconds for 100000 records. */
+struct slow_map {
+  template <class EMIT>
+  void operator()(std::string_view s, EMIT& emit) const {
+    std::this_thread::sleep_for(std::chrono::microseconds(100));
+    emit(std::string_view(s));
+  }
+};
+
+/** @brief Reduce function that loops by itself, at least a second per 1000 records. */
+counter_t slow_reduce(std::vector<counter_t>&& data) {
+  counter_t res = std::move(data.front());
+  for (std::size_t i = 1; i != data.size(); ++i) {
+    yamr::core::check_stop();
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    res.add_count(data[i].count());
+  }
+  return res;
+}
+
+/** @brief Seconds since "start". */
+double since(steady_clock::time_point start) {
+  return std::chrono::duration<double>(steady_clock::now() - start).count();
+}
+
+void test_cancel_map() {
+  map_reduce_t mr(2, 2);
+  auto job = mr.run_async(input(2, 100000), yamr::core::map_each<counter_t>(slow_map{}), nullptr,
+                          yamr::core::sorted_reducer_func<counter_t>,
+                          yamr::core::reducer_func<counter_t>);
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+  steady_clock::time_point start = steady_clock::now();
+  job.cancel();
+  CHECK_THROWS(job.get(), yamr::core::job_cancelled);
+  CHECK(since(start) < 2.0);
+}
+
+void test_timeout_reduce() {
+  steady_clock::time_point start = steady_clock::now();
+  map_reduce_t mr(2, 1);
+  auto job = mr.run_async(input(2, 10000), yamr::core::mapper_func<counter_t, std::string_view>,
+                          nullptr, slow_reduce, yamr::core::reducer_func<counter_t>,
+                          std::chrono::milliseconds(500));
+  CHECK_THROWS(job.get(), yamr::core::job_cancelled);
+  CHECK(since(start) < 3.0);
+}
+
+void test_check_stop_outside_job() {
+  for (std::size_t i = 0; i != 4096; ++i)
+    yamr::core::check_stop();
+}
+
+} /* :: */
+
+int main() {
+  test_cancel_map();
+  test_timeout_reduce();
+  test_check_stop_outside_job();
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,72 @@
+/**
+ * @file corpus.hpp
+ * @brief Input of the tests of the jobs and its reference answer.
+ *
+ * @author Maxim <john.jasper.doe@gmail.com>
+ * @date 2020
+ */
+
+#ifndef TESTS_CORPUS_HPP_
+#define TESTS_CORPUS_HPP_
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "common/split.hpp"
+
+/** @brief The namespace of the tests */
+namespace tests {
+
+/**
+ * @brief Make the input of the jobs.
+ * @details Names of a small alphabet, so that many records share long
+ * prefixes and some of them repeat; the records are separated by line feeds
+ * and now and then by a run of other whitespace.
+ * @param [in] num - number of records.
+ * @param [in] seed - seed of the generator.
+ * @return Input.
+ */
+inline std::string make_input(std::size_t num, unsigned seed) {
+  std::mt19937 gen(seed);
+  std::uniform_int_distribution<std::size_t> len(1, 12);
+  std::uniform_int_distribution<int> letter(0, 3);
+
+  std::string res;
+  for (std::size_t i = 0; i != num; ++i) {
+    for (std::size_t n = len(gen); n != 0; --n)
+      res += static_cast<char>('a' + letter(gen));
+    res += "@otus.owl";
+    res += i % 7 == 0 ? " \t" : "\n";
+  }
+  return res;
+}
+
+/**
+ * @brief The reference answer: the longest prefix shared by two records, plus one.
+ * @param [in] buf - input.
+ * @return Minimal identifying prefix size.
+ */
+inline std::size_t expected_size(std::string_view buf) {
+  std::vector<std::string_view> records;
+  for (const std::vector<std::string_view>& chunk : common::split_records(buf, 1))
+    records.insert(records.end(), chunk.begin(), chunk.end());
+  std::sort(records.begin(), records.end());
+
+  std::size_t res = 0;
+  for (std::size_t i = 1; i < records.size(); ++i) {
+    std::string_view lhs = records[i - 1];
+    std::string_view rhs = records[i];
+    std::size_t len = 0;
+    while (len != lhs.size() && len != rhs.size() && lhs[len] == rhs[len])
+      ++len;
+    res = std::max(res, len);
+  }
+  return res + 1;
+}
+
+} /* tests:: */
+
+#endif /* TESTS_CORPUS_HPP_ */
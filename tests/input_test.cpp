@@ -0,0 +1,134 @@
+/**
+ * @file input_test.cpp
+ * @brief Tests of the mapped input and of the input splitting.
+ *
+ * @author Maxim <john.jasper.doe@gmail.com>
+ * @date 2020
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include "tests/test.hpp"
+
+#include "common/mapped_file.hpp"
+#include "common/split.hpp"
+
+namespace {
+
+/** @brief Records as "std::istream >>" reads them, the reference of the splitting. */
+std::vector<std::string> stream_records(const std::string& buf) {
+  std::istringstream is(buf);
+  std::vector<std::string> res;
+  std::string tmp;
+  while (is >> tmp)
+    res.push_back(tmp);
+  return res;
+}
+
+void test_split_records() {
+  const std::string buf =
+      "  first@otus.owl\tfist@otus.owl\n\nfisddt@otus.owl \r\n\v\ffist@otus.owl x\n"
+      "fissdsdfdst@otus.owl   fsdfist@otus.owl\n";
+  const std::vector<std::string> expected = stream_records(buf);
+
+  for (std::size_t parts = 0; parts != 12; ++parts) {
+    std::vector<std::vector<std::string_view>> chunks = common::split_records(buf, parts);
+    CHECK(chunks.size() <= std::max<std::size_t>(parts, 1));
+
+    std::vector<std::string> records;
+    for (const std::vector<std::string_view>& chunk : chunks) {
+      CHECK(!chunk.empty());
+      for (std::string_view rec : chunk) {
+        /* a view into the buffer, not a copy */
+        CHECK(rec.data() >= buf.data() && rec.data() + rec.size() <= buf.data() + buf.size());
+        records.emplace_back(rec);
+      }
+    }
+    CHECK(records == expected);
+  }
+
+  CHECK(common::split_records("", 3).empty());
+  CHECK(common::split_records(" \n\t ", 3).empty());
+}
+
+void test_split() {
+  std::vector<std::string> input;
+  for (std::size_t i = 0; i != 100; ++i)
+    input.push_back(std::string(i % 10 == 0 ? 50 : 5, 'a'));
+
+  for (std::size_t parts : {1, 3, 7, 200}) {
+    std::vector<std::vector<std::string>> res =
+        common::split(std::vector<std::string>(input), parts);
+    CHECK(res.size() <= parts);
+
+    /* contiguous parts of about the same weight */
+    const std::size_t total = 100 * 6 + 10 * 45;
+    std::vector<std::string> all;
+    for (const std::vector<std::string>& part : res) {
+      CHECK(!part.empty());
+      std::size_t weight = 0;
+      for (const std::string& str : part)
+        weight += common::record_weight(str);
+      CHECK(weight <= total / parts + 51);
+      all.insert(all.end(), part.begin(), part.end());
+    }
+    CHECK(all == input);
+  }
+  CHECK(common::split(std::vector<std::string>{}, 3).empty());
+
+  /* a cluster is closed only between two different elements */
+  std::vector<std::string> sorted{"a", "a", "a", "a", "b", "c", "c", "d"};
+  std::vector<std::vector<std::string>> clusters =
+      common::split_reduce(std::vector<std::string>(sorted), 4);
+  std::vector<std::string> all;
+  for (const std::vector<std::string>& cluster : clusters) {
+    CHECK(!cluster.empty());
+    CHECK(all.empty() || all.back() != cluster.front());
+    all.insert(all.end(), cluster.begin(), cluster.end());
+  }
+  CHECK(all == sorted);
+}
+
+void test_mapped_file() {
+  const std::string path = "input_test.txt";
+  const std::string content = "first@otus.owl\nfist@otus.owl\n";
+  {
+    std::ofstream os(path, std::ios::binary);
+    os << content;
+  }
+  {
+    common::mapped_file file(path);
+    CHECK(file.size() == content.size());
+    CHECK(file.view() == content);
+
+    common::mapped_file moved(std::move(file));
+    CHECK(file.view().empty());
+    CHECK(moved.view() == content);
+  }
+
+  std::ofstream(path, std::ios::trunc).close();
+  {
+    common::mapped_file file(path);
+    CHECK(file.size() == 0);
+    CHECK(file.view().empty());
+  }
+  std::remove(path.c_str());
+
+  CHECK_THROWS(common::mapped_file(path), std::system_error);
+}
+
+} /* :: */
+
+int main() {
+  test_split_records();
+  test_split();
+  test_mapped_file();
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,341 @@
+/**
+ * @file job_test.cpp
+ * @brief Tests of the results of the "Map Reduce" jobs.
+ *
+ * @author Maxim <john.jasper.doe@gmail.com>
+ * @date 2020
+ */
+
+#include <algorithm>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "tests/corpus.hpp"
+#include "tests/test.hpp"
+
+#include "core/mapper.hpp"
+#include "core/mapreduce.hpp"
+#include "core/reducer.hpp"
+#include "core/trie_job.hpp"
+
+#include "common/counter.hpp"
+#include "common/prefix_trie.hpp"
+#include "common/split.hpp"
+
+namespace {
+
+using str_counter_t = common::counter<std::string>;
+using view_counter_t = common::counter<std::string_view>;
+
+using tests::expected_size;
+using tests::make_input;
+
+/** @brief Get the minimal identifying prefix size from the result of a job. */
+template <class T>
+std::size_t prefix_size(const T& res) {
+  return (res.count() > 1 ? res.strlen() : 0) + 1;
+}
+
+/** @brief Settings of a tested job. */
+struct options {
+  std::size_t mnum{3};
+  std::size_t rnum{2};
+  yamr::core::shuffle_mode shuffle{yamr::core::shuffle_mode::sort_merge};
+  bool combine{false};
+  /** @brief Bytes of map output kept in memory, zero - no spilling. */
+  std::size_t spill_budget{0};
+  /** @brief Bytes of input per chunk of the stream mode, zero - the input is split at once. */
+  std::size_t chunk{0};
+  /** @brief State file of the incremental mode, empty - the job is run on its input alone. */
+  std::string state{};
+};
+
+/** @brief Settings of the jobs compared with the reference. */
+std::vector<options> all_options() {
+  using yamr::core::shuffle_mode;
+  std::vector<options> res;
+  for (shuffle_mode shuffle : {shuffle_mode::sort_merge, shuffle_mode::hash}) {
+    for (bool combine : {false, true}) {
+      res.push_back(options{1, 1, shuffle, combine});
+      res.push_back(options{3, 2, shuffle, combine});
+      res.push_back(options{4, 5, shuffle, combine});
+    }
+  }
+
+  /* a budget of a few records spills almost every batch */
+  res.push_back(options{1, 1, shuffle_mode::sort_merge, false, 1024});
+  res.push_back(options{3, 2, shuffle_mode::sort_merge, true, 1024});
+  res.push_back(options{4, 5, shuffle_mode::sort_merge, false, 64 * 1024});
+
+  /* chunks of a single record, of a few records and of the whole input */
+  res.push_back(options{1, 1, shuffle_mode::sort_merge, false, 0, 1});
+  res.push_back(options{3, 2, shuffle_mode::sort_merge, true, 0, 64});
+  res.push_back(options{4, 5, shuffle_mode::sort_merge, false, 0, 64 * 1024});
+  return res;
+}
+
+/** @brief Set up the job. */
+template <class MR>
+void setup(MR& mr, const options& opts) {
+  mr.set_shuffle(opts.shuffle);
+  mr.set_spill(opts.spill_budget, std::filesystem::temp_directory_path().string());
+}
+
+/** @brief Run the job on the input, at once or as a stream of chunks. */
+template <class MR, class... F>
+auto run_job(MR& mr, const options& opts, std::string_view buf, F&&... funcs) {
+  if (!opts.state.empty())
+    return mr.run_incremental(common::split_records(buf, opts.mnum), std::forward<F>(funcs)...,
+                              opts.state);
+  if (opts.chunk != 0) {
+    common::record_reader reader(buf, opts.chunk);
+    return mr.run_stream([&reader] { return reader.next(); }, std::forward<F>(funcs)...);
+  }
+  return mr.run(common::split_records(buf, opts.mnum), std::forward<F>(funcs)...);
+}
+
+/**
+ * @brief The reference "substr" job: every prefix of every record is counted.
+ * @details The keys are strings, or views into the input and the arenas of the job.
+ */
+template <class COUNTER = str_counter_t>
+std::size_t substr_job(std::string_view buf, const options& opts = options{}) {
+  using namespace yamr::core;
+  map_reduce<std::string_view, COUNTER, COUNTER, COUNTER> mr(opts.mnum, opts.rnum);
+  setup(mr, opts);
+  cfunc_ptr_t<COUNTER> cfunc;
+  if (opts.combine)
+    cfunc = combiner_func<COUNTER>;
+  COUNTER res = run_job(mr, opts, buf, mapper_func<COUNTER, std::string_view>, cfunc,
+                        reducer_func<COUNTER>, reducer_func<COUNTER>);
+  return prefix_size(res);
+}
+
+/**
+ * @brief The "substr" job on callables known at compile time.
+ * @details The per-record map function through the emit adapter, the reduce
+ * functions as lambdas and the combiner as a function pointer or "nullptr".
+ * The reduce tasks get sorted data and use the single-pass reducer.
+ */
+std::size_t emit_job(std::string_view buf, const options& opts) {
+  using namespace yamr::core;
+  map_reduce<std::string_view, view_counter_t, view_counter_t, view_counter_t> mr(opts.mnum,
+                                                                                  opts.rnum);
+  setup(mr, opts);
+  auto mfunc = map_each<view_counter_t>(prefix_map<view_counter_t>{});
+  auto rfunc = [](std::vector<view_counter_t>&& arg) {
+    return sorted_reducer_func<view_counter_t>(std::move(arg));
+  };
+  auto ofunc = [](std::vector<view_counter_t>&& arg) {
+    return reducer_func<view_counter_t>(std::move(arg));
+  };
+  view_counter_t res = opts.combine
+                           ? run_job(mr, opts, buf, mfunc, &combiner_func<view_counter_t>, rfunc,
+                                     ofunc)
+                           : run_job(mr, opts, buf, mfunc, nullptr, rfunc, ofunc);
+  return prefix_size(res);
+}
+
+/** @brief The "trie" job: the records are put into prefix tries. */
+std::size_t trie_job(std::string_view buf, const options& opts = options{}) {
+  using namespace yamr::core;
+  map_reduce<std::string_view, common::prefix_trie, str_counter_t, str_counter_t> mr(opts.mnum,
+                                                                                     opts.rnum);
+  setup(mr, opts);
+  cfunc_ptr_t<common::prefix_trie> cfunc;
+  if (opts.combine)
+    cfunc = trie_combiner_func;
+  str_counter_t res = run_job(mr, opts, buf, trie_mapper_func<std::string_view>, cfunc,
+                              trie_reducer_func<str_counter_t>, reducer_func<str_counter_t>);
+  return prefix_size(res);
+}
+
+void test_combiner() {
+  std::vector<str_counter_t> data;
+  for (const char* key : {"fist", "first", "fist", "fi", "fist"})
+    data.emplace_back(std::string(key));
+
+  std::vector<str_counter_t> res = yamr::core::combiner_func(std::move(data));
+  CHECK(res.size() == 3);
+  CHECK(res[0].key() == "fi" && res[0].count() == 1);
+  CHECK(res[1].key() == "first" && res[1].count() == 1);
+  CHECK(res[2].key() == "fist" && res[2].count() == 3);
+}
+
+void test_sorted_reducer() {
+  /* the same length of the result and the same choice of a shared prefix as "reducer_func" */
+  for (unsigned seed = 1; seed != 6; ++seed) {
+    for (std::vector<std::string_view>& chunk : common::split_records(make_input(50, seed), 1)) {
+      std::vector<str_counter_t> prefixes =
+          yamr::core::mapper_func<str_counter_t, std::string_view>(std::move(chunk));
+      std::sort(prefixes.begin(), prefixes.end());
+      std::vector<str_counter_t> copy;
+      for (const str_counter_t& obj : prefixes)
+        copy.emplace_back(std::string(obj.key()), obj.count());
+
+      str_counter_t res = yamr::core::sorted_reducer_func(std::move(prefixes));
+      str_counter_t expected = yamr::core::reducer_func(std::move(copy));
+      CHECK(res.strlen() == expected.strlen());
+      CHECK((res.count() > 1) == (expected.count() > 1));
+    }
+  }
+
+  /* a single record, no prefix shared */
+  std::vector<str_counter_t> single;
+  single.emplace_back(std::string("first"));
+  CHECK(yamr::core::sorted_reducer_func(std::move(single)).key() == "first");
+}
+
+void test_empty() {
+  /* no records: an empty prefix of no count */
+  str_counter_t res = yamr::core::reducer_func(std::vector<str_counter_t>());
+  CHECK(res.key().empty() && res.count() == 0);
+  res = yamr::core::sorted_reducer_func(std::vector<str_counter_t>());
+  CHECK(res.key().empty() && res.count() == 0);
+
+  for (std::string_view input : {"", " \n\t\n"}) {
+    CHECK(expected_size(input) == 1);
+    for (const options& opts : all_options()) {
+      CHECK(substr_job(input, opts) == 1);
+      CHECK(substr_job<view_counter_t>(input, opts) == 1);
+      CHECK(emit_job(input, opts) == 1);
+      CHECK(trie_job(input, opts) == 1);
+    }
+  }
+}
+
+void test_substr() {
+  const std::string fixed =
+      "first@otus.owl fist@otus.owl fisddt@otus.owl fist@otus.owl fissdsdfdst@otus.owl "
+      "fsdfist@otus.owl fisdst@otus.owl fifghssdft@otus.owl";
+  CHECK(expected_size(fixed) == 14);
+  CHECK(substr_job(fixed) == 14);
+
+  /* most records are one key, the reduce ranges are balanced by weight around it */
+  std::string skewed;
+  for (std::size_t i = 0; i != 300; ++i)
+    skewed += i % 10 == 0 ? "fist@otus.owl\n" : "first@otus.owl\n";
+  CHECK(substr_job(skewed, options{4, 5, yamr::core::shuffle_mode::sort_merge, true}) ==
+        expected_size(skewed));
+
+  for (unsigned seed = 1; seed != 4; ++seed) {
+    const std::string input = make_input(200, seed);
+    const std::size_t expected = expected_size(input);
+    for (const options& opts : all_options()) {
+      CHECK(substr_job(input, opts) == expected);
+      CHECK(substr_job<view_counter_t>(input, opts) == expected);
+      CHECK(emit_job(input, opts) == expected);
+    }
+  }
+}
+
+void test_trie() {
+  /* no prefix shared, a single record and records of one letter */
+  for (std::string_view input : {"abc bcd cde", "first@otus.owl", "a a b"}) {
+    for (const options& opts : all_options())
+      CHECK(trie_job(input, opts) == substr_job(input));
+  }
+
+  for (unsigned seed = 1; seed != 4; ++seed) {
+    const std::string input = make_input(200, seed);
+    const std::size_t expected = substr_job(input);
+    for (const options& opts : all_options())
+      CHECK(trie_job(input, opts) == expected);
+  }
+}
+
+void test_spill() {
+  using yamr::core::shuffle_mode;
+
+  /* a map task of one worker maps many batches, so there are more runs than are merged at once */
+  const std::string input = make_input(5000, 7);
+  const std::size_t expected = substr_job(input);
+  CHECK(substr_job(input, options{1, 1, shuffle_mode::sort_merge, false, 64 * 1024}) == expected);
+  CHECK(substr_job(input, options{3, 2, shuffle_mode::sort_merge, true, 64 * 1024}) == expected);
+  /* the keys read back from the runs live in the arenas of the job */
+  for (bool combine : {false, true}) {
+    const options opts{3, 2, shuffle_mode::sort_merge, combine, 64 * 1024};
+    CHECK(substr_job<view_counter_t>(input, opts) == expected);
+  }
+  CHECK(trie_job(input, options{3, 2, shuffle_mode::sort_merge, false, 16 * 1024}) == expected);
+}
+
+void test_incremental() {
+  using yamr::core::shuffle_mode;
+  const std::string state =
+      (std::filesystem::temp_directory_path() / "job_test-incremental.state").string();
+
+  /* every run adds its input to the state, the last result is for all inputs so far */
+  for (bool combine : {false, true}) {
+    for (std::size_t (*job)(std::string_view, const options&) :
+         {&substr_job<str_counter_t>, &substr_job<view_counter_t>, &trie_job}) {
+      std::filesystem::remove(state);
+      const options opts{3, 2, shuffle_mode::sort_merge, combine, 0, 0, state};
+      std::string all;
+      for (unsigned seed = 1; seed != 4; ++seed) {
+        all += make_input(100, seed);
+        CHECK(job(make_input(100, seed), opts) == expected_size(all));
+      }
+    }
+  }
+  std::filesystem::remove(state);
+}
+
+void test_incremental_failed() {
+  using namespace yamr::core;
+  const std::string state =
+      (std::filesystem::temp_directory_path() / "job_test-failed.state").string();
+  std::filesystem::remove(state);
+
+  auto job = [&state](std::string_view buf, bool fail) {
+    map_reduce<std::string_view, str_counter_t, str_counter_t, str_counter_t> mr(3, 2);
+    auto rfunc = [fail](std::vector<str_counter_t>&& arg) {
+      if (fail)
+        throw std::runtime_error("Reducer failed");
+      return reducer_func<str_counter_t>(std::move(arg));
+    };
+    str_counter_t res = mr.run_incremental(common::split_records(buf, 3),
+                                           mapper_func<str_counter_t, std::string_view>, nullptr,
+                                           rfunc, reducer_func<str_counter_t>, state);
+    return prefix_size(res);
+  };
+
+  /* the second run repeats the input and fails in the reduce stage, the input is not counted */
+  const std::string first = make_input(100, 1);
+  const std::string third = make_input(100, 3);
+  CHECK(expected_size(first + first + third) != expected_size(first + third));
+  CHECK(job(first, false) == expected_size(first));
+  CHECK_THROWS(job(first, true), std::runtime_error);
+  CHECK(!std::filesystem::exists(state + ".tmp"));
+  CHECK(job(third, false) == expected_size(first + third));
+  std::filesystem::remove(state);
+
+  /* a state that is not a file is named by the error */
+  std::filesystem::create_directory(state);
+  try {
+    job(first, false);
+    CHECK(!"a directory state must throw");
+  }
+  catch (const std::runtime_error& e) {
+    CHECK(std::string(e.what()).find(state) != std::string::npos);
+  }
+  std::filesystem::remove(state);
+}
+
+} /* :: */
+
+int main() {
+  test_combiner();
+  test_sorted_reducer();
+  test_empty();
+  test_substr();
+  test_trie();
+  test_spill();
+  test_incremental();
+  test_incremental_failed();
+  return EXIT_SUCCESS;
+}
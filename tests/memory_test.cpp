@@ -0,0 +1,123 @@
+/**
+ * @file memory_test.cpp
+ * @brief Tests of the memory limit of the "Map Reduce".
+ *
+ * @author Maxim <john.jasper.doe@gmail.com>
+ * @date 2020
+ */
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "tests/test.hpp"
+
+#include "core/mapper.hpp"
+#include "core/mapreduce.hpp"
+#include "core/reducer.hpp"
+
+#include "common/counter.hpp"
+#include "common/memory_budget.hpp"
+
+namespace {
+
+using counter_t = common::counter<std::string_view>;
+using map_reduce_t = yamr::core::map_reduce<std::string_view, counter_t, counter_t, counter_t>;
+
+const std::size_t mib = 1 << 20;
+
+/** @brief Peak resident set size of the process in bytes. */
+std::size_t peak_rss() {
+  rusage usage{};
+  ::getrusage(RUSAGE_SELF, &usage);
+  return static_cast<std::size_t>(usage.ru_maxrss) * 1024;
+}
+
+/** @brief Distinct lines of 24 bytes, the prefixes of all of them take about 60 MiB. */
+std::string make_text(std::size_t lines) {
+  std::string res;
+  res.reserve(lines * 24);
+  for (std::size_t i = 0; i != lines; ++i) {
+    std::string line = std::to_string(i * 2654435761u % 1000000007u);
+    line.resize(24, 'a' + static_cast<char>(i % 26));
+    res += line;
+  }
+  return res;
+}
+
+std::vector<std::string_view> make_lines(const std::string& text) {
+  std::vector<std::string_view> res;
+  for (std::size_t pos = 0; pos != text.size(); pos += 24)
+    res.push_back(std::string_view(text).substr(pos, 24));
+  return res;
+}
+
+/** @brief Run the job, get the growth of the peak resident set size. */
+std::size_t run(map_reduce_t& mr, const std::string& text) {
+  std::vector<std::string_view> lines = make_lines(text);
+  std::size_t before = peak_rss();
+  counter_t res = mr.run(std::move(lines), yamr::core::mapper_func<counter_t, std::string_view>,
+                         yamr::core::sorted_reducer_func<counter_t>,
+                         yamr::core::reducer_func<counter_t>);
+  CHECK(!res.key().empty());
+  return peak_rss() - before;
+}
+
+void test_acquire_waits() {
+  common::memory_budget budget(10);
+  common::memory_budget::lease first = budget.acquire(8);
+  common::memory_budget::lease second;
+  std::thread waiter([&] { second = budget.acquire(4); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  CHECK(budget.used() == 8);
+  first.reset();
+  waiter.join();
+  CHECK(budget.used() == 4);
+
+  second.resize(6);
+  CHECK(second.detach() == 6);
+  CHECK(budget.used() == 6);
+
+  /* no other lease is out, nothing would be released, so an oversized one does not wait */
+  CHECK(budget.acquire(20).bytes() == 20);
+  CHECK(budget.used() == 6);
+}
+
+void test_limit_bounds_rss() {
+  const std::size_t limit = 8 * mib;
+  std::string text = make_text(100000);
+
+  map_reduce_t limited(4, 4);
+  limited.set_spill(0, std::filesystem::temp_directory_path().string());
+  limited.set_memory_limit(limit);
+  std::size_t limited_growth = run(limited, text);
+
+  std::size_t reported = 0;
+  for (const yamr::core::stage_stats& st : limited.stats().stages())
+    reported = std::max(reported, st.mem_peak_bytes);
+
+  map_reduce_t unlimited(4, 4);
+  std::size_t unlimited_growth = run(unlimited, text);
+
+  /* the job takes about its limit and reports it, the process stays near it; the rest is
+     the memory freed by the tasks that the allocator keeps, without the limit it is many times
+     more */
+  CHECK(reported >= limit / 2 && reported <= limit + limit / 4);
+  CHECK(limited_growth <= 3 * limit);
+  CHECK(unlimited_growth > 4 * limit);
+}
+
+} /* :: */
+
+int main() {
+  test_acquire_waits();
+  test_limit_bounds_rss();
+  return EXIT_SUCCESS;
+}
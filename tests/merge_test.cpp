@@ -0,0 +1,154 @@
+/**
+ * @file merge_test.cpp
+ * @brief Tests of the merge of sorted runs.
+ *
+ * @author Maxim <john.jasper.doe@gmail.com>
+ * @date 2020
+ */
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "tests/test.hpp"
+
+#include "common/extractor.hpp"
+#include "common/loser_tree.hpp"
+#include "common/merge.hpp"
+
+namespace {
+
+/** @brief Make sorted runs of random sizes, with many repeated keys. */
+std::vector<std::vector<int>> make_runs(std::size_t num, unsigned seed) {
+  std::mt19937 gen(seed);
+  std::uniform_int_distribution<std::size_t> size(0, 300);
+  std::uniform_int_distribution<int> key(0, 100);
+
+  std::vector<std::vector<int>> res(num);
+  for (std::vector<int>& run : res) {
+    for (std::size_t n = size(gen); n != 0; --n)
+      run.push_back(key(gen));
+    std::sort(run.begin(), run.end());
+  }
+  return res;
+}
+
+/** @brief All elements of the runs in order, the reference of the merges. */
+std::vector<int> sorted_all(const std::vector<std::vector<int>>& runs) {
+  std::vector<int> res;
+  for (const std::vector<int>& run : runs)
+    res.insert(res.end(), run.begin(), run.end());
+  std::sort(res.begin(), res.end());
+  return res;
+}
+
+void test_merge() {
+  for (unsigned seed = 1; seed != 6; ++seed) {
+    std::vector<std::vector<int>> runs = make_runs(seed, seed);
+    const std::vector<int> expected = sorted_all(runs);
+    CHECK(common::merge<int>(std::move(runs)) == expected);
+  }
+}
+
+void test_split_runs() {
+  for (unsigned seed = 1; seed != 6; ++seed) {
+    for (std::size_t parts : {1, 2, 3, 7, 64}) {
+      std::vector<std::vector<int>> runs = make_runs(4, seed);
+      const std::vector<int> expected = sorted_all(runs);
+
+      std::vector<std::vector<std::vector<int>>> ranges =
+          common::split_runs<int>(std::move(runs), parts);
+      CHECK(ranges.size() <= parts);
+
+      /* the merged ranges follow each other, a key is never in two of them */
+      std::vector<int> res;
+      for (std::vector<std::vector<int>>& range : ranges) {
+        CHECK(!range.empty());
+        std::vector<int> merged = common::merge<int>(std::move(range));
+        CHECK(!merged.empty());
+        CHECK(res.empty() || res.back() < merged.front());
+        res.insert(res.end(), merged.begin(), merged.end());
+      }
+      CHECK(res == expected);
+    }
+  }
+
+  CHECK(common::split_runs<int>({}, 3).empty());
+  CHECK(common::split_runs<int>({{}, {}}, 3).empty());
+}
+
+void test_spread() {
+  /* one key outweighs a range: it is kept whole or shared out between ranges of its own */
+  std::vector<std::vector<int>> runs = make_runs(4, 11);
+  for (std::vector<int>& run : runs) {
+    run.insert(run.end(), 1000, 50);
+    std::sort(run.begin(), run.end());
+  }
+  const std::vector<int> expected = sorted_all(runs);
+
+  for (bool spread : {false, true}) {
+    std::vector<std::vector<std::vector<int>>> ranges =
+        common::split_runs<int>(std::vector<std::vector<int>>(runs), 4, spread);
+    CHECK(ranges.size() <= 4);
+
+    std::size_t hot = 0;
+    std::vector<int> res;
+    for (std::vector<std::vector<int>>& range : ranges) {
+      std::vector<int> merged = common::merge<int>(std::move(range));
+      CHECK(!merged.empty());
+      /* only the spread key may continue the previous range */
+      CHECK(res.empty() || res.back() < merged.front() || (spread && merged.front() == 50));
+      hot += std::count(merged.begin(), merged.end(), 50) != 0;
+      res.insert(res.end(), merged.begin(), merged.end());
+    }
+    CHECK(res == expected);
+    CHECK(spread ? hot > 1 : hot == 1);
+  }
+}
+
+/** @brief Move-only element, the merges must never copy it. */
+struct boxed {
+  std::unique_ptr<int> val;
+
+  friend bool operator<(const boxed& lhs, const boxed& rhs) {
+    return *lhs.val < *rhs.val;
+  }
+};
+
+void test_loser_tree() {
+  /* no runs, one run, an odd and an even number of runs, some of them empty */
+  for (std::size_t num = 0; num != 10; ++num) {
+    std::vector<std::vector<int>> runs = make_runs(num, static_cast<unsigned>(num) + 10);
+    if (num > 2)
+      runs[1].clear();
+    const std::vector<int> expected = sorted_all(runs);
+    std::vector<std::vector<int>> copy = runs;
+    CHECK(common::merge_tournament<int>(std::move(runs)) == expected);
+
+    std::vector<common::extractor<int>> sources;
+    for (std::vector<int>& run : copy)
+      sources.emplace_back(std::move(run));
+    std::vector<int> res;
+    common::merge_stream(std::move(sources), [&res](int&& val) { res.push_back(val); });
+    CHECK(res == expected);
+  }
+
+  std::vector<std::vector<boxed>> runs(3);
+  for (int i = 0; i != 30; ++i)
+    runs[static_cast<std::size_t>(i) % 3].push_back(boxed{std::make_unique<int>(i)});
+  std::vector<boxed> res = common::merge_tournament<boxed>(std::move(runs));
+  CHECK(res.size() == 30);
+  for (int i = 0; i != 30; ++i)
+    CHECK(res[static_cast<std::size_t>(i)].val && *res[static_cast<std::size_t>(i)].val == i);
+}
+
+} /* :: */
+
+int main() {
+  test_merge();
+  test_split_runs();
+  test_spread();
+  test_loser_tree();
+  return EXIT_SUCCESS;
+}
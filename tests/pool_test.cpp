@@ -0,0 +1,170 @@
+/**
+ * @file pool_test.cpp
+ * @brief Tests of the thread pool.
+ *
+ * @author Maxim <john.jasper.doe@gmail.com>
+ * @date 2020
+ */
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <mutex>
+#include <set>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "tests/test.hpp"
+
+#include "core/mapper.hpp"
+#include "core/mapreduce.hpp"
+#include "core/numa.hpp"
+#include "core/reducer.hpp"
+#include "core/thread_pool.hpp"
+
+#include "common/counter.hpp"
+#include "common/split.hpp"
+
+namespace {
+
+using yamr::core::thread_pool;
+using str_counter_t = common::counter<std::string>;
+
+/** @brief Wait for the future, a task that hangs fails the test. */
+template <class T>
+T get_bounded(std::future<T>& fut) {
+  CHECK(fut.wait_for(std::chrono::seconds(10)) == std::future_status::ready);
+  return fut.get();
+}
+
+void test_submit() {
+  thread_pool pool(3);
+  CHECK(pool.size() == 3);
+
+  std::vector<std::future<std::size_t>> futures;
+  for (std::size_t i = 0; i != 100; ++i)
+    futures.push_back(pool.submit([i] { return i * i; }));
+  for (std::size_t i = 0; i != futures.size(); ++i)
+    CHECK(get_bounded(futures[i]) == i * i);
+
+  /* only a worker runs the tasks of the pool */
+  CHECK(!pool.run_pending_task());
+}
+
+void test_stealing() {
+  thread_pool pool(4);
+
+  /* the tasks submitted from a worker go to its own queue, idle workers steal them */
+  std::future<std::size_t> res = pool.submit([&pool] {
+    std::mutex mtx;
+    std::set<std::thread::id> threads;
+    std::vector<std::future<void>> futures;
+    for (std::size_t i = 0; i != 16; ++i) {
+      futures.push_back(pool.submit([&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        std::lock_guard<std::mutex> lock(mtx);
+        threads.insert(std::this_thread::get_id());
+      }));
+    }
+    for (std::future<void>& fut : futures)
+      pool.wait(fut);
+    return threads.size();
+  });
+  CHECK(get_bounded(res) > 1);
+}
+
+void test_nested_wait() {
+  thread_pool pool(1);
+
+  /* a stage started from the only worker runs its tasks while it waits */
+  std::future<std::size_t> res = pool.submit([&pool] {
+    yamr::core::mapper<std::size_t, std::size_t> mapper(
+        [](std::vector<std::size_t>&& arg) { return arg; });
+    std::vector<std::vector<std::size_t>> parts{{1, 2}, {3}, {4, 5, 6}};
+    std::size_t sum = 0;
+    for (const std::vector<std::size_t>& part : mapper.exec(std::move(parts), pool)) {
+      for (std::size_t val : part)
+        sum += val;
+    }
+    return sum;
+  });
+  CHECK(get_bounded(res) == 21);
+}
+
+void test_shared_pool() {
+  using namespace yamr::core;
+  const std::string input =
+      "first@otus.owl fist@otus.owl fisddt@otus.owl fist@otus.owl fissdsdfdst@otus.owl "
+      "fsdfist@otus.owl fisdst@otus.owl fifghssdft@otus.owl";
+
+  /* two jobs at once on one pool of fewer workers than their tasks */
+  thread_pool pool(2);
+  auto job = [&] {
+    map_reduce<std::string_view, str_counter_t, str_counter_t, str_counter_t> mr(4, 3, pool);
+    str_counter_t res =
+        mr.run(common::split_records(input, 4), mapper_func<str_counter_t, std::string_view>,
+               reducer_func<str_counter_t>, reducer_func<str_counter_t>);
+    return res.strlen();
+  };
+  std::future<std::size_t> first = std::async(std::launch::async, job);
+  std::future<std::size_t> second = std::async(std::launch::async, job);
+  CHECK(get_bounded(first) == 13);
+  CHECK(get_bounded(second) == 13);
+}
+
+void test_numa() {
+  using yamr::core::numa_topology;
+  namespace fs = std::filesystem;
+
+  CHECK(yamr::core::_details::parse_cpulist("0-3,8,10-11\n") ==
+        std::vector<std::size_t>({0, 1, 2, 3, 8, 10, 11}));
+  CHECK(yamr::core::_details::parse_cpulist("x,2,,1-1,2") == std::vector<std::size_t>({1, 2}));
+
+  /* a fake sysfs: a node of a CPU that is not allowed and a name that is not a node are dropped */
+  const std::vector<std::size_t> allowed = yamr::core::_details::allowed_cpus();
+  const fs::path root = fs::temp_directory_path() / "pool_test-numa";
+  fs::remove_all(root);
+  for (const char* node : {"node0", "node1", "node2", "nodex"})
+    fs::create_directories(root / node);
+  std::ofstream(root / "node0" / "cpulist") << allowed.front() << "\n";
+  std::ofstream(root / "node1" / "cpulist") << allowed.back() << "\n";
+  std::ofstream(root / "node2" / "cpulist") << allowed.back() + 1 << "\n";
+  std::ofstream(root / "nodex" / "cpulist") << allowed.front() << "\n";
+
+  numa_topology topo = numa_topology::detect(root.string());
+  CHECK(topo.size() == 2);
+  CHECK(topo.cpus(0) == std::vector<std::size_t>({allowed.front()}));
+  CHECK(topo.cpus(1) == std::vector<std::size_t>({allowed.back()}));
+  fs::remove_all(root);
+
+  /* no description, one node of all allowed CPUs */
+  topo = numa_topology::detect(root.string());
+  CHECK(topo.size() == 1 && topo.cpus(0) == allowed);
+
+  /* the placed workers give the same result */
+  using namespace yamr::core;
+  const std::string input = "first@otus.owl fist@otus.owl fisddt@otus.owl fsdfist@otus.owl";
+  using placement = thread_pool::placement;
+  for (placement where : {placement::core, placement::node}) {
+    map_reduce<std::string_view, str_counter_t, str_counter_t, str_counter_t> mr(3, 2, where);
+    str_counter_t res =
+        mr.run(common::split_records(input, 3), mapper_func<str_counter_t, std::string_view>,
+               reducer_func<str_counter_t>, reducer_func<str_counter_t>);
+    CHECK(res.strlen() == 3);
+  }
+}
+
+} /* :: */
+
+int main() {
+  test_submit();
+  test_stealing();
+  test_nested_wait();
+  test_shared_pool();
+  test_numa();
+  return EXIT_SUCCESS;
+}
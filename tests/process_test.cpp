@@ -0,0 +1,163 @@
+/**
+ * @file process_test.cpp
+ * @brief Tests of the worker processes of the "Map Reduce".
+ *
+ * @author Maxim <john.jasper.doe@gmail.com>
+ * @date 2020
+ */
+
+#include <unistd.h>
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "tests/test.hpp"
+
+#include "core/mapper.hpp"
+#include "core/mapreduce.hpp"
+#include "core/process_pool.hpp"
+#include "core/reducer.hpp"
+#include "core/thread_pool.hpp"
+
+#include "common/counter.hpp"
+#include "common/split.hpp"
+
+namespace {
+
+using counter_t = common::counter<std::string_view>;
+using map_reduce_t = yamr::core::map_reduce<std::string_view, counter_t, counter_t, counter_t>;
+
+const std::string input =
+    "first@otus.owl fist@otus.owl fisddt@otus.owl fist@otus.owl fissdsdfdst@otus.owl "
+    "fsdfist@otus.owl fisdst@otus.owl fifghssdft@otus.owl first@otus.owl";
+
+/** @brief Path of a file of the test, unique for the test process. */
+std::string test_file(const std::string& name) {
+  return (std::filesystem::temp_directory_path() /
+          ("process_test-" + std::to_string(::getpid()) + "-" + name))
+      .string();
+}
+
+/** @brief Count the lines of the file. */
+std::size_t count_lines(const std::string& path) {
+  std::ifstream is(path);
+  std::size_t res = 0;
+  for (std::string line; std::getline(is, line);)
+    ++res;
+  return res;
+}
+
+void test_same_result() {
+  using namespace yamr::core;
+  const std::string work = std::filesystem::temp_directory_path().string();
+
+  for (bool combine : {false, true}) {
+    cfunc_ptr_t<counter_t> cfunc;
+    if (combine)
+      cfunc = combiner_func<counter_t>;
+    /* the pool of the reference job is gone before the workers are forked */
+    std::optional<counter_t> expected;
+    {
+      map_reduce_t threads(3, 2);
+      expected = threads.run(common::split_records(input, 3),
+                             mapper_func<counter_t, std::string_view>, cfunc,
+                             reducer_func<counter_t>, reducer_func<counter_t>);
+    }
+
+    map_reduce_t procs(3, 2);
+    procs.set_processes(2, work);
+    counter_t res = procs.run_processes(common::split_records(input, 3),
+                                        mapper_func<counter_t, std::string_view>, cfunc,
+                                        reducer_func<counter_t>, reducer_func<counter_t>);
+    CHECK(res.key() == expected->key());
+    CHECK(res.count() == expected->count());
+  }
+}
+
+/** @brief Count the threads of the process. */
+std::size_t count_threads() {
+  std::size_t res = 0;
+  for (auto it = std::filesystem::directory_iterator("/proc/self/task");
+       it != std::filesystem::directory_iterator(); ++it)
+    ++res;
+  return res;
+}
+
+void test_no_threads() {
+  using namespace yamr::core;
+  const std::string work = std::filesystem::temp_directory_path().string();
+  auto job = [](map_reduce_t& mr, bool procs) {
+    auto split = common::split_records(input, 3);
+    counter_t res = procs ? mr.run_processes(std::move(split),
+                                             mapper_func<counter_t, std::string_view>, nullptr,
+                                             reducer_func<counter_t>, reducer_func<counter_t>)
+                          : mr.run(std::move(split), mapper_func<counter_t, std::string_view>,
+                                   nullptr, reducer_func<counter_t>, reducer_func<counter_t>);
+    return res.count();
+  };
+
+  /* the pool started by a job of threads is stopped before the workers are forked */
+  map_reduce_t mr(3, 2);
+  mr.set_processes(2, work);
+  const std::size_t expected = job(mr, false);
+  CHECK(count_threads() > 1);
+  CHECK(job(mr, true) == expected);
+  CHECK(count_threads() == 1);
+  /* and started again by the next job of threads */
+  CHECK(job(mr, false) == expected);
+
+  /* the threads of a shared pool can not be stopped */
+  thread_pool pool(2);
+  map_reduce_t shared(3, 2, pool);
+  shared.set_processes(2, work);
+  CHECK_THROWS(job(shared, true), std::logic_error);
+}
+
+void test_retry() {
+  /* the first worker that gets the command dies, the command is given to a new one */
+  const std::string marker = test_file("marker");
+  yamr::core::process_pool pool(2, [&marker](const std::string& cmd) {
+    if (cmd == "2" && !std::filesystem::exists(marker)) {
+      std::ofstream(marker).close();
+      std::abort();
+    }
+    return "done " + cmd;
+  });
+
+  std::vector<std::string> answers = pool.run({"0", "1", "2", "3"}, 3);
+  CHECK(std::filesystem::exists(marker));
+  CHECK(answers == std::vector<std::string>({"done 0", "done 1", "done 2", "done 3"}));
+  std::filesystem::remove(marker);
+}
+
+void test_always_dies() {
+  /* every attempt leaves a line before the worker dies */
+  const std::string log = test_file("log");
+  yamr::core::process_pool pool(2, [&log](const std::string& cmd) -> std::string {
+    if (cmd == "bad") {
+      std::ofstream(log, std::ios::app) << cmd << std::endl;
+      std::abort();
+    }
+    return cmd;
+  });
+
+  CHECK_THROWS(pool.run({"good", "bad"}, 3), std::runtime_error);
+  CHECK(count_lines(log) == 3);
+  std::filesystem::remove(log);
+}
+
+} /* :: */
+
+int main() {
+  test_same_result();
+  test_no_threads();
+  test_retry();
+  test_always_dies();
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,177 @@
+/**
+ * @file serializer_test.cpp
+ * @brief Tests of the binary serializers of the records.
+ *
+ * @author Maxim <john.jasper.doe@gmail.com>
+ * @date 2020
+ */
+
+#include <unistd.h>
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "tests/test.hpp"
+
+#include "common/arena.hpp"
+#include "common/counter.hpp"
+#include "common/prefix_sketch.hpp"
+#include "common/prefix_trie.hpp"
+#include "common/serializer.hpp"
+#include "common/spill.hpp"
+
+namespace {
+
+using trie_serializer = common::serializer<common::prefix_trie>;
+
+common::prefix_trie make_trie() {
+  common::prefix_trie res('f');
+  for (const char* word : {"first", "fist", "fisddt", "fist", "fsdfist"})
+    res.insert(word);
+  return res;
+}
+
+std::string write(const common::prefix_trie& obj) {
+  std::ostringstream os;
+  trie_serializer::write(os, obj);
+  return os.str();
+}
+
+std::optional<common::prefix_trie> read(const std::string& data) {
+  std::istringstream is(data);
+  common::string_arena arena;
+  return trie_serializer::read(is, arena);
+}
+
+void test_round_trip() {
+  common::prefix_trie src = make_trie();
+  std::string data = write(src) + write(src);
+
+  std::istringstream is(data);
+  common::string_arena arena;
+  for (int i = 0; i != 2; ++i) {
+    std::optional<common::prefix_trie> res = trie_serializer::read(is, arena);
+    CHECK(res);
+    CHECK(res->key() == 'f');
+    CHECK(res->count() == src.count());
+    CHECK(res->deepest_shared() == src.deepest_shared());
+  }
+  CHECK(!trie_serializer::read(is, arena));
+}
+
+void test_truncated() {
+  std::string data = write(make_trie());
+  for (std::size_t size = 1; size != data.size(); ++size)
+    CHECK_THROWS(read(data.substr(0, size)), std::runtime_error);
+}
+
+void test_corrupted() {
+  std::string data = write(make_trie());
+  data.back() ^= 1;
+  CHECK_THROWS(read(data), std::runtime_error);
+}
+
+void test_bad_links() {
+  using node = common::prefix_trie::node;
+  /* out of the nodes, a cycle, a node linked twice, unsorted children */
+  const std::vector<std::vector<node>> bad = {
+      {{2, 5, 0, 'f'}, {1, 0, 0, 'i'}},
+      {{2, 1, 0, 'f'}, {1, 0, 1, 'i'}},
+      {{2, 1, 0, 'f'}, {1, 2, 2, 'i'}, {1, 0, 0, 'r'}},
+      {{2, 1, 0, 'f'}, {1, 0, 2, 's'}, {1, 0, 0, 'i'}}};
+  for (std::vector<node> nodes : bad)
+    CHECK_THROWS(read(write(common::prefix_trie(std::move(nodes)))), std::runtime_error);
+}
+
+/** @brief Every cut of a record throws, a cut before it is the end of the stream. */
+template <class T>
+void check_truncated(const T& obj) {
+  std::ostringstream os;
+  common::serializer<T>::write(os, obj);
+  std::string data = os.str();
+
+  common::string_arena arena;
+  for (std::size_t size = 0; size != data.size(); ++size) {
+    std::istringstream is(data.substr(0, size));
+    if (size == 0)
+      CHECK(!common::serializer<T>::read(is, arena));
+    else
+      CHECK_THROWS(common::serializer<T>::read(is, arena), std::runtime_error);
+  }
+  std::istringstream is(data);
+  CHECK(common::serializer<T>::read(is, arena));
+}
+
+void test_truncated_counter() {
+  check_truncated(common::counter<std::string_view>(std::string_view("first"), 3));
+  check_truncated(common::counter<std::string>(std::string("first"), 3));
+}
+
+void test_truncated_sketch() {
+  common::prefix_sketch sketch(4, 2);
+  for (const char* word : {"first", "fist", "fisddt"})
+    sketch.insert(word);
+  check_truncated(sketch);
+}
+
+/** @brief Path of a file of the test, unique for the test process. */
+std::string test_file(const std::string& name) {
+  return (std::filesystem::temp_directory_path() /
+          ("serializer_test-" + std::to_string(::getpid()) + "-" + name))
+      .string();
+}
+
+void test_run() {
+  using counter_t = common::counter<std::string_view>;
+  std::vector<counter_t> data;
+  for (const char* key : {"fi", "first", "fist", "fsdfist"})
+    data.emplace_back(key, data.size() + 1);
+  const std::string path = test_file("run");
+  CHECK(common::write_run(data, path) == data.size());
+
+  common::string_arena arena;
+  std::vector<counter_t> res = common::read_run<counter_t>(path, arena);
+  CHECK(res.size() == data.size());
+  for (std::size_t i = 0; i != res.size(); ++i)
+    CHECK(res[i].key() == data[i].key() && res[i].count() == data[i].count());
+
+  /* the count of the records is out of the checksum, a flipped one must still throw */
+  std::string bytes;
+  {
+    std::ifstream is(path, std::ios::binary);
+    bytes.assign(std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>());
+  }
+  CHECK(bytes.front() == static_cast<char>(data.size()));
+  for (std::size_t count : {data.size() - 1, data.size() + 1}) {
+    bytes.front() = static_cast<char>(count);
+    std::ofstream(path, std::ios::binary | std::ios::trunc) << bytes;
+    CHECK_THROWS(common::read_run<counter_t>(path, arena), std::runtime_error);
+  }
+
+  /* a run cut after its last block misses the end of the run: two zero varints and a checksum */
+  bytes.front() = static_cast<char>(data.size());
+  bytes.resize(bytes.size() - 6);
+  std::ofstream(path, std::ios::binary | std::ios::trunc) << bytes;
+  CHECK_THROWS(common::read_run<counter_t>(path, arena), std::runtime_error);
+  std::filesystem::remove(path);
+}
+
+} /* :: */
+
+int main() {
+  test_round_trip();
+  test_truncated();
+  test_corrupted();
+  test_bad_links();
+  test_truncated_counter();
+  test_truncated_sketch();
+  test_run();
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,91 @@
+/**
+ * @file sort_test.cpp
+ * @brief Tests of the sort of the records.
+ *
+ * @author Maxim <john.jasper.doe@gmail.com>
+ * @date 2020
+ */
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "tests/test.hpp"
+
+#include "common/counter.hpp"
+#include "common/sort.hpp"
+
+namespace {
+
+/** @brief Keys of a small alphabet, with long shared prefixes, repeats and empty keys. */
+std::vector<std::string> make_keys(std::size_t num, unsigned seed) {
+  std::mt19937 gen(seed);
+  std::uniform_int_distribution<std::size_t> len(0, 40);
+  std::uniform_int_distribution<int> letter(0, 2);
+
+  std::vector<std::string> res;
+  for (std::size_t i = 0; i != num; ++i) {
+    std::string key;
+    for (std::size_t n = len(gen); n != 0; --n)
+      key += static_cast<char>('a' + letter(gen));
+    res.push_back(std::move(key));
+  }
+  return res;
+}
+
+void test_strings() {
+  /* below and above the insertion sort cutoff */
+  for (std::size_t num : {0, 1, 2, 15, 17, 100, 3000}) {
+    std::vector<std::string> keys = make_keys(num, static_cast<unsigned>(num));
+    std::vector<std::string> expected = keys;
+    std::sort(expected.begin(), expected.end());
+
+    std::vector<std::string_view> views(keys.begin(), keys.end());
+    common::sort_records(views);
+    CHECK(std::equal(views.begin(), views.end(), expected.begin(), expected.end()));
+
+    common::sort_records(keys);
+    CHECK(keys == expected);
+
+    /* already sorted input is left as is */
+    common::sort_records(keys);
+    CHECK(keys == expected);
+  }
+}
+
+void test_counters() {
+  std::vector<std::string> keys = make_keys(1000, 7);
+  std::vector<common::counter<std::string>> data;
+  for (const std::string& key : keys)
+    data.emplace_back(std::string(key));
+  std::sort(keys.begin(), keys.end());
+
+  common::sort_records(data);
+  CHECK(data.size() == keys.size());
+  for (std::size_t i = 0; i != data.size(); ++i)
+    CHECK(data[i].key() == keys[i] && data[i].count() == 1);
+}
+
+void test_fallback() {
+  std::mt19937 gen(3);
+  std::uniform_int_distribution<int> val(-100, 100);
+  std::vector<int> data(500);
+  for (int& v : data)
+    v = val(gen);
+  std::vector<int> expected = data;
+  std::sort(expected.begin(), expected.end());
+
+  common::sort_records(data);
+  CHECK(data == expected);
+}
+
+} /* :: */
+
+int main() {
+  test_strings();
+  test_counters();
+  test_fallback();
+  return EXIT_SUCCESS;
+}
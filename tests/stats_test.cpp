@@ -0,0 +1,135 @@
+/**
+ * @file stats_test.cpp
+ * @brief Tests of the statistics of the stages.
+ *
+ * @author Maxim <john.jasper.doe@gmail.com>
+ * @date 2020
+ */
+
+#include <filesystem>
+#include <optional>
+#include <set>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "tests/test.hpp"
+
+#include "core/mapreduce.hpp"
+#include "core/stats.hpp"
+
+#include "common/counter.hpp"
+#include "common/split.hpp"
+
+namespace {
+
+using counter_t = common::counter<std::string_view>;
+using map_reduce_t = yamr::core::map_reduce<std::string_view, counter_t, counter_t, counter_t>;
+
+const std::string input =
+    "first@otus.owl fist@otus.owl fisddt@otus.owl fist@otus.owl fissdsdfdst@otus.owl "
+    "fsdfist@otus.owl fisdst@otus.owl fifghssdft@otus.owl";
+
+/** @brief Get the names of the stages, every one of them has counted its records. */
+std::set<std::string> counted_stages(const yamr::core::job_stats& stats) {
+  std::set<std::string> res;
+  for (const yamr::core::stage_stats& st : stats.stages()) {
+    CHECK(st.records_in != 0);
+    CHECK(st.records_out != 0);
+    res.insert(st.name);
+  }
+  return res;
+}
+
+/** @brief Run the job on the input split at once. */
+void run(map_reduce_t& mr) {
+  using namespace yamr::core;
+  counter_t res = mr.run(common::split_records(input, 3), mapper_func<counter_t, std::string_view>,
+                         combiner_func<counter_t>, reducer_func<counter_t>,
+                         reducer_func<counter_t>);
+  CHECK(res.strlen() == 13);
+}
+
+void test_sort_merge() {
+  map_reduce_t mr(3, 2);
+  run(mr);
+  const std::set<std::string> names = counted_stages(mr.stats());
+  for (const char* name : {"map", "combine", "sort", "split_reduce", "merge", "reduce", "output"})
+    CHECK(names.count(name) == 1);
+  CHECK(names.count("partition") == 0);
+
+  /* the statistics accumulate until they are cleared */
+  const std::size_t records = mr.stats().stage("map").records_in;
+  run(mr);
+  CHECK(mr.stats().stage("map").records_in == 2 * records);
+  mr.stats().clear();
+  CHECK(mr.stats().stages().empty());
+}
+
+void test_hash() {
+  map_reduce_t mr(3, 2);
+  mr.set_shuffle(yamr::core::shuffle_mode::hash);
+  run(mr);
+  const std::set<std::string> names = counted_stages(mr.stats());
+  for (const char* name : {"map", "partition", "sort", "merge", "reduce", "output"})
+    CHECK(names.count(name) == 1);
+  CHECK(names.count("split_reduce") == 0);
+}
+
+void test_spill() {
+  map_reduce_t mr(3, 2);
+  mr.set_spill(1, std::filesystem::temp_directory_path().string());
+  run(mr);
+  const std::set<std::string> names = counted_stages(mr.stats());
+  for (const char* name : {"map", "sort", "spill", "merge", "spill_read", "reduce", "output"})
+    CHECK(names.count(name) == 1);
+}
+
+void test_stream() {
+  using namespace yamr::core;
+  common::record_reader reader(input, 16);
+  map_reduce_t mr(3, 2);
+  counter_t res = mr.run_stream([&reader] { return reader.next(); },
+                                mapper_func<counter_t, std::string_view>, nullptr,
+                                reducer_func<counter_t>, reducer_func<counter_t>);
+  CHECK(res.strlen() == 13);
+  const std::set<std::string> names = counted_stages(mr.stats());
+  for (const char* name : {"read", "map", "partition", "sort", "merge", "reduce", "output"})
+    CHECK(names.count(name) == 1);
+
+  std::ostringstream os;
+  mr.stats().write_json(os);
+  CHECK(os.str().find("{\"name\": \"read\"") != std::string::npos);
+  CHECK(os.str().find("\"process_peak_rss_kb\": ") != std::string::npos);
+}
+
+void test_nested_cpu() {
+  using namespace yamr::core;
+  job_stats stats;
+  {
+    stage_timer outer(stats, stats.stage("outer"), stage_timer::kind::task);
+    {
+      /* a task run inside another one on the same thread, e.g. by a waiting worker */
+      stage_timer inner(stats, stats.stage("inner"), stage_timer::kind::task);
+      const double start = _details::thread_cpu_ms();
+      while (_details::thread_cpu_ms() - start < 50) {
+      }
+    }
+  }
+
+  /* the time of the inner task is counted once, in its own stage */
+  CHECK(stats.stage("inner").cpu_ms >= 50);
+  CHECK(stats.stage("outer").cpu_ms < 10);
+}
+
+} /* :: */
+
+int main() {
+  test_sort_merge();
+  test_hash();
+  test_spill();
+  test_stream();
+  test_nested_cpu();
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,96 @@
+/**
+ * @file stream_test.cpp
+ * @brief Tests of the streaming mode of the "Map Reduce".
+ *
+ * @author Maxim <john.jasper.doe@gmail.com>
+ * @date 2020
+ */
+
+#include <chrono>
+#include <future>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+#include "tests/test.hpp"
+
+#include "core/mapper.hpp"
+#include "core/mapreduce.hpp"
+#include "core/reducer.hpp"
+
+#include "common/counter.hpp"
+
+namespace {
+
+using counter_t = common::counter<std::string_view>;
+using map_reduce_t = yamr::core::map_reduce<std::string_view, counter_t, counter_t, counter_t>;
+using chunk_t = std::optional<std::vector<std::string_view>>;
+
+/** @brief Endless source, the job ends only if it stops reading. */
+chunk_t endless() {
+  return std::vector<std::string_view>(64, "first@otus.owl");
+}
+
+/** @brief Run the job on another thread, a job that hangs fails the test. */
+template <class F>
+void run_bounded(F&& job) {
+  std::future<void> res = std::async(std::launch::async, std::forward<F>(job));
+  CHECK(res.wait_for(std::chrono::seconds(10)) == std::future_status::ready);
+  res.get();
+}
+
+void test_result() {
+  std::size_t chunks = 0;
+  auto source = [&chunks]() -> chunk_t {
+    if (chunks++ == 100)
+      return std::nullopt;
+    return endless();
+  };
+
+  map_reduce_t mr(3, 2);
+  counter_t res = mr.run_stream(source, yamr::core::mapper_func<counter_t, std::string_view>,
+                                nullptr, yamr::core::reducer_func<counter_t>,
+                                yamr::core::reducer_func<counter_t>);
+  CHECK(res.key() == "first@otus.owl");
+  CHECK(res.count() == 100 * 64);
+}
+
+void test_mapper_throws() {
+  auto mfunc = [](std::vector<std::string_view>&&) -> std::vector<counter_t> {
+    throw std::runtime_error("map failed");
+  };
+
+  run_bounded([&] {
+    map_reduce_t mr(3, 2);
+    CHECK_THROWS(mr.run_stream(endless, mfunc, nullptr, yamr::core::reducer_func<counter_t>,
+                               yamr::core::reducer_func<counter_t>),
+                 std::runtime_error);
+  });
+}
+
+void test_source_throws() {
+  std::size_t chunks = 0;
+  auto source = [&chunks]() -> chunk_t {
+    if (chunks++ == 10)
+      throw std::runtime_error("read failed");
+    return endless();
+  };
+
+  run_bounded([&] {
+    map_reduce_t mr(3, 2);
+    CHECK_THROWS(mr.run_stream(source, yamr::core::mapper_func<counter_t, std::string_view>,
+                               nullptr, yamr::core::reducer_func<counter_t>,
+                               yamr::core::reducer_func<counter_t>),
+                 std::runtime_error);
+  });
+}
+
+} /* :: */
+
+int main() {
+  test_result();
+  test_mapper_throws();
+  test_source_throws();
+  return EXIT_SUCCESS;
+}
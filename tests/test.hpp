@@ -0,0 +1,41 @@
+/**
+ * @file test.hpp
+ * @brief Checks of the tests.
+ *
+ * @author Maxim <john.jasper.doe@gmail.com>
+ * @date 2020
+ */
+
+#ifndef TESTS_TEST_HPP_
+#define TESTS_TEST_HPP_
+
+#include <cstdlib>
+#include <iostream>
+
+/**
+ * @brief Check the condition, a failed check ends the test at once.
+ * @details The process is ended without unwinding, so a check may fail while
+ * tasks of the tested job are still blocked.
+ */
+#define CHECK(cond)                                                                      \
+  do {                                                                                   \
+    if (!(cond)) {                                                                       \
+      std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #cond << std::endl; \
+      std::_Exit(EXIT_FAILURE);                                                          \
+    }                                                                                    \
+  } while (false)
+
+/** @brief Check that the expression throws the exception. */
+#define CHECK_THROWS(expr, error) \
+  do {                            \
+    bool thrown = false;          \
+    try {                         \
+      static_cast<void>(expr);    \
+    }                             \
+    catch (const error&) {        \
+      thrown = true;              \
+    }                             \
+    CHECK(thrown && #expr);       \
+  } while (false)
+
+#endif /* TESTS_TEST_HPP_ */
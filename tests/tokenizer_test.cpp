@@ -0,0 +1,101 @@
+/**
+ * @file tokenizer_test.cpp
+ * @brief Tests of the whitespace tokenizer and of the split of a string.
+ *
+ * @author Maxim <john.jasper.doe@gmail.com>
+ * @date 2020
+ */
+
+#include <random>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "tests/test.hpp"
+
+#include "common/split.hpp"
+#include "common/tokenizer.hpp"
+
+namespace {
+
+/** @brief The former split of a string by a regular expression, the reference of "split". */
+std::vector<std::string> regex_split(const std::string& str) {
+  std::regex ws_re("\\s+");
+  return std::vector<std::string>{std::sregex_token_iterator(str.begin(), str.end(), ws_re, -1),
+                                  std::sregex_token_iterator()};
+}
+
+/** @brief The byte by byte tokenizer, the reference of "tokenize". */
+std::vector<std::string_view> naive_tokenize(std::string_view buf) {
+  auto is_space = [](char c) { return c == ' ' || (c >= '\t' && c <= '\r'); };
+  std::vector<std::string_view> res;
+  std::size_t pos = 0;
+  while (pos != buf.size()) {
+    while (pos != buf.size() && is_space(buf[pos]))
+      ++pos;
+    std::size_t first = pos;
+    while (pos != buf.size() && !is_space(buf[pos]))
+      ++pos;
+    if (pos != first)
+      res.push_back(buf.substr(first, pos - first));
+  }
+  return res;
+}
+
+/** @brief Random text of short tokens, with zero and high bytes, and of every whitespace. */
+std::string make_text(std::size_t size, unsigned seed) {
+  static const char chars[] = "ab\0\x80\xff \t\n\v\f\r";
+  std::mt19937 gen(seed);
+  std::uniform_int_distribution<std::size_t> pick(0, sizeof(chars) - 2);
+
+  std::string res;
+  for (std::size_t i = 0; i != size; ++i)
+    res += chars[pick(gen)];
+  return res;
+}
+
+void test_split() {
+  /* empty, only whitespace, leading, trailing and repeated whitespace */
+  for (const char* str : {"", " ", " \t\n", "a", " a", "a ", " a ", "a  b", "\t\na\v\fb\r",
+                          "\x85 a\xa0", "first@otus.owl   fist@otus.owl\n"})
+    CHECK(common::split(str) == regex_split(str));
+  CHECK(common::split("") == std::vector<std::string>({""}));
+  CHECK(common::split(" a  b ") == std::vector<std::string>({"", "a", "b"}));
+
+  for (unsigned seed = 1; seed != 50; ++seed) {
+    const std::string str = make_text(seed * 5, seed);
+    CHECK(common::split(str) == regex_split(str));
+  }
+}
+
+void test_levels() {
+  using common::simd_level;
+
+  /* a token and a run of whitespace end on every position around the block boundaries */
+  for (std::size_t size = 0; size != 200; ++size) {
+    for (std::size_t cut : {size / 2, std::size_t{63}, std::size_t{64}, std::size_t{65}}) {
+      std::string buf(size, 'a');
+      for (std::size_t i = cut; i < size && i < cut + 3; ++i)
+        buf[i] = ' ';
+      const std::vector<std::string_view> expected = naive_tokenize(buf);
+      for (simd_level level : {simd_level::scalar, simd_level::sse2, simd_level::avx2})
+        CHECK(common::tokenize(buf, level) == expected);
+    }
+  }
+
+  for (unsigned seed = 1; seed != 50; ++seed) {
+    const std::string buf = make_text(seed * 7, seed);
+    const std::vector<std::string_view> expected = naive_tokenize(buf);
+    for (simd_level level : {simd_level::scalar, simd_level::sse2, simd_level::avx2})
+      CHECK(common::tokenize(buf, level) == expected);
+  }
+}
+
+} /* :: */
+
+int main() {
+  test_split();
+  test_levels();
+  return EXIT_SUCCESS;
+}